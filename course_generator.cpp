@@ -5,6 +5,8 @@
 #include <random>
 #include <algorithm>
 
+#include "generator_seed.h"
+
 using namespace std;
 
 struct TimeSlot {
@@ -67,7 +69,7 @@ private:
     };
 
 public:
-    CourseGenerator() : rng(random_device{}()) {}
+    explicit CourseGenerator(uint32_t seed) : rng(seed) {}
 
     string getNextHour(const string& time) {
         int hour = stoi(time.substr(0, 2));
@@ -226,8 +228,10 @@ public:
     }
 };
 
-int main() {
-    CourseGenerator generator;
+int main(int argc, char* argv[]) {
+    uint32_t seed = 0;
+    if (!seedFromArgs(argc, argv, seed)) return 1;
+    CourseGenerator generator(seed);
     vector<Course> courses = generator.generateCourses();
     generator.saveCoursesToFile(courses, "courses.txt");
     generator.printCourseSchedules(courses);
@@ -0,0 +1,32 @@
+#ifndef GENERATOR_SEED_H
+#define GENERATOR_SEED_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+// Seed from the first command-line argument, or a random one that is
+// printed so the run can be reproduced. Returns false after printing the
+// usage when the argument is not a number.
+inline bool seedFromArgs(int argc, char* argv[], uint32_t& seed) {
+    if (argc > 2 || (argc == 2 && argv[1][0] == '\0')) {
+        std::cerr << "Usage: " << argv[0] << " [seed]" << std::endl;
+        return false;
+    }
+    if (argc == 2) {
+        char* end = nullptr;
+        seed = std::strtoul(argv[1], &end, 10);
+        if (*end != '\0') {
+            std::cerr << "Invalid seed: " << argv[1] << std::endl;
+            std::cerr << "Usage: " << argv[0] << " [seed]" << std::endl;
+            return false;
+        }
+    } else {
+        seed = std::random_device{}();
+    }
+    std::cout << "Random seed: " << seed << std::endl;
+    return true;
+}
+
+#endif
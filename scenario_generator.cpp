@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <set>
 
+#include "generator_seed.h"
+
 using namespace std;
 
 struct ScenarioConfig {
@@ -69,7 +71,7 @@ private:
     };
 
 public:
-    ScenarioGenerator() : rng(random_device{}()) {}
+    explicit ScenarioGenerator(uint32_t seed) : rng(seed) {}
 
     vector<string> generateTimeSlots(bool use_half_hour) {
         vector<string> slots;
@@ -428,8 +430,10 @@ public:
     }
 };
 
-int main() {
-    ScenarioGenerator generator;
+int main(int argc, char* argv[]) {
+    uint32_t seed = 0;
+    if (!seedFromArgs(argc, argv, seed)) return 1;
+    ScenarioGenerator generator(seed);
     vector<ScenarioConfig> scenarios = ScenarioGenerator::getScenarios();
 
     cout << "=== Course Scheduling Scenario Generator ===" << endl;
@@ -1,435 +1,4781 @@
+#include "scheduler.h"
+
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <algorithm>
 #include <random>
-#include <sstream>
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <charconv>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <memory>
+#include <cstring>
+#include <type_traits>
+#include <cerrno>
+#include <cstdio>
+#include <chrono>
+#include <limits>
+#include <cctype>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
 
 using namespace std;
 
+// Everything up to Scheduler::Impl is internal to the library
+namespace {
+
+// Fixed set of worker threads, each with its own task deque. submit() deals
+// tasks out round-robin; a worker takes the oldest task from its own deque
+// and, once that is empty, steals the newest from another, so a few large
+// tasks do not leave the other threads idle. A single worker runs tasks in
+// submission order. wait() blocks until every task
+// submitted so far has finished.
+class ThreadPool {
+private:
+    struct TaskDeque {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<TaskDeque>> deques;
+    mutex lock;
+    condition_variable work_ready;
+    condition_variable all_done;
+    size_t queued = 0;                      // tasks not yet claimed by a worker
+    size_t unfinished = 0;
+    size_t next_deque = 0;
+    bool stopping = false;
+
+    static inline thread_local size_t worker_index = 0;
+
+    // Takes a task from the worker's own deque, or steals one
+    bool takeTask(size_t self, function<void()>& task) {
+        for (size_t k = 0; k < deques.size(); k++) {
+            TaskDeque& source = *deques[(self + k) % deques.size()];
+            lock_guard<mutex> guard(source.lock);
+            if (source.tasks.empty()) continue;
+            if (k == 0) {
+                task = move(source.tasks.front());
+                source.tasks.pop_front();
+            } else {
+                task = move(source.tasks.back());
+                source.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self) {
+        worker_index = self;
+        while (true) {
+            {
+                unique_lock<mutex> guard(lock);
+                work_ready.wait(guard, [this] { return stopping || queued > 0; });
+                if (queued == 0) return;
+                queued--;
+            }
+            // A claimed task is in some deque, though another worker may
+            // steal it first; then an unclaimed one is still there
+            function<void()> task;
+            while (!takeTask(self, task)) this_thread::yield();
+            task();
+            {
+                lock_guard<mutex> guard(lock);
+                if (--unfinished == 0) all_done.notify_all();
+            }
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t thread_count) {
+        for (size_t i = 0; i < max<size_t>(thread_count, 1); i++) {
+            deques.emplace_back(new TaskDeque);
+        }
+        for (size_t i = 0; i < deques.size(); i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // Index of the worker running the calling task, for per-worker scratch
+    static size_t currentWorker() { return worker_index; }
+
+    void submit(function<void()> task) {
+        size_t target;
+        {
+            lock_guard<mutex> guard(lock);
+            target = next_deque++ % deques.size();
+            unfinished++;
+        }
+        {
+            lock_guard<mutex> guard(deques[target]->lock);
+            deques[target]->tasks.push_back(move(task));
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            queued++;
+        }
+        work_ready.notify_one();
+    }
+
+    void wait() {
+        unique_lock<mutex> guard(lock);
+        all_done.wait(guard, [this] { return unfinished == 0; });
+    }
+};
+
+// Writes a large text file through two big buffers: one is filled by the
+// formatting thread while a background thread writes the other, so the file
+// goes out in a few large write() calls that overlap with formatting.
+// Integers are converted with to_chars, free of locale and stream state.
+class ResultWriter {
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    int fd = -1;
+    vector<char> buffers[2];
+    size_t active = 0;                      // buffer being formatted into
+    size_t used = 0;
+
+    thread flusher;
+    mutex lock;
+    condition_variable changed;
+    size_t pending_size = 0;                // bytes of the other buffer left to write
+    bool pending = false;
+    bool closing = false;
+    bool failed = false;
+
+    void flushLoop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            changed.wait(guard, [this] { return pending || closing; });
+            if (!pending) return;
+
+            const char* data = buffers[active ^ 1].data();
+            size_t remaining = pending_size;
+            guard.unlock();
+            bool ok = true;
+            while (remaining > 0) {
+                ssize_t written = ::write(fd, data, remaining);
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    ok = false;
+                    break;
+                }
+                data += written;
+                remaining -= written;
+            }
+            guard.lock();
+            if (!ok) failed = true;
+            pending = false;
+            changed.notify_all();
+        }
+    }
+
+    // Hands the active buffer to the flusher and switches to the other one
+    void handOff() {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [this] { return !pending; });
+        pending_size = used;
+        pending = true;
+        active ^= 1;
+        used = 0;
+        changed.notify_all();
+    }
+
+    char* reserve(size_t size) {
+        if (used + size > BUFFER_SIZE) handOff();
+        return buffers[active].data() + used;
+    }
+
+public:
+    ResultWriter() = default;
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+    ~ResultWriter() { close(); }
+
+    bool open(const string& filename) {
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        buffers[0].resize(BUFFER_SIZE);
+        buffers[1].resize(BUFFER_SIZE);
+        flusher = thread([this] { flushLoop(); });
+        return true;
+    }
+
+    // Flushes everything and closes the file; false if any write failed
+    bool close() {
+        if (fd < 0) return !failed;
+        if (used > 0) handOff();
+        {
+            lock_guard<mutex> guard(lock);
+            closing = true;
+        }
+        changed.notify_all();
+        flusher.join();
+        if (::close(fd) != 0) failed = true;
+        fd = -1;
+        return !failed;
+    }
+
+    // Overwrites bytes of a finished file in place, for fields whose values
+    // are only known once everything after them has been written
+    static bool patch(const string& filename, size_t offset, string_view text) {
+        int patch_fd = ::open(filename.c_str(), O_WRONLY);
+        if (patch_fd < 0) return false;
+        bool ok = pwrite(patch_fd, text.data(), text.size(), offset) == (ssize_t)text.size();
+        return ::close(patch_fd) == 0 && ok;
+    }
+
+    ResultWriter& operator<<(string_view text) {
+        while (!text.empty()) {
+            if (used == BUFFER_SIZE) handOff();
+            size_t count = min(text.size(), BUFFER_SIZE - used);
+            memcpy(buffers[active].data() + used, text.data(), count);
+            used += count;
+            text.remove_prefix(count);
+        }
+        return *this;
+    }
+
+    ResultWriter& operator<<(const char* text) { return *this << string_view(text); }
+
+    ResultWriter& operator<<(char c) {
+        *reserve(1) = c;
+        used++;
+        return *this;
+    }
+
+    ResultWriter& operator<<(long long value) {
+        char* out = reserve(24);
+        used = to_chars(out, out + 24, value).ptr - buffers[active].data();
+        return *this;
+    }
+
+    ResultWriter& operator<<(int value) { return *this << (long long)value; }
+    ResultWriter& operator<<(size_t value) { return *this << (long long)value; }
+
+    // Same text as an ostream with default flags (%g, 6 significant digits)
+    ResultWriter& operator<<(double value) {
+        char* out = reserve(32);
+        used += snprintf(out, 32, "%g", value);
+        return *this;
+    }
+};
+
+// Read-only memory mapping of an input file. Records parsed from it keep
+// string_views into the mapped bytes, so the mapping must outlive them.
+class MappedFile {
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept : bytes(other.bytes), length(other.length) {
+        other.bytes = nullptr;
+        other.length = 0;
+    }
+    ~MappedFile() {
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+    }
+
+    bool open(const string& filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+
+        // mmap rejects empty files; an empty mapping is simply no data
+        if (info.st_size > 0) {
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd);
+                return false;
+            }
+            madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+            bytes = static_cast<const char*>(mapped);
+            length = info.st_size;
+        }
+        ::close(fd);
+        return true;
+    }
+
+    string_view view() const { return string_view(bytes, length); }
+};
+
+// Enrollment journal: a header followed by fixed-size records, appended and
+// never rewritten in place. Sequence numbers count records since the journal
+// was created; base is the number of the file's first record, so a file
+// emptied after a snapshot keeps counting where it left off.
+const char JOURNAL_MAGIC[8] = {'S', 'C', 'H', 'E', 'D', 'W', 'A', 'L'};
+const uint32_t JOURNAL_VERSION = 1;
+const uint32_t JOURNAL_DROP = 1u << 31;     // set in JournalRecord::course for a drop
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t seed;                          // of the run that created the journal
+    uint64_t base;
+};
+
+struct JournalRecord {
+    uint32_t student;
+    uint32_t course;
+};
+
+static bool syncDirectoryOf(const string& filename) {
+    size_t slash = filename.find_last_of('/');
+    string directory = slash == string::npos ? "." : slash == 0 ? "/" : filename.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+// append() buffers a record and returns its sequence number; sync(sequence)
+// returns once every record up to it is on disk. Callers of sync share the
+// work: whoever holds the flush lock writes everything buffered so far with
+// one fdatasync, and callers it covered return without touching the file.
+// A failed write or fdatasync breaks the journal for good; the records that
+// never reached the disk are handed back by discardUnsynced.
+class Journal {
+private:
+    int fd = -1;
+    string path;
+    JournalHeader header = {};
+    mutex buffer_lock;
+    vector<JournalRecord> buffer;
+    uint64_t appended = 0;
+    mutex flush_lock;
+    vector<JournalRecord> flushing;
+    uint64_t durable = 0;
+    vector<JournalRecord> unsynced;         // records of the flush that failed
+    atomic<bool> failed{false};
+
+    static bool writeAll(int fd, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = ::write(fd, bytes, size);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            bytes += written;
+            size -= written;
+        }
+        return true;
+    }
+
+
+public:
+    Journal() = default;
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+    ~Journal() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    static bool readHeader(const string& filename, JournalHeader& header) {
+        ifstream file(filename, ios::binary);
+        return file.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+               memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) == 0 && header.version == JOURNAL_VERSION;
+    }
+
+    // Opens the journal, creating its header only when the file is new or
+    // empty; a file with any other header is refused with an error. Records
+    // already in the file are returned for replay; a record torn by a crash
+    // mid-write is cut off.
+    bool open(const string& filename, uint32_t seed, vector<JournalRecord>& records) {
+        records.clear();
+        path = filename;
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            cerr << "Error opening journal: " << filename << ": " << strerror(errno) << endl;
+            return false;
+        }
+
+        if (info.st_size == 0) {
+            memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+            header.version = JOURNAL_VERSION;
+            header.seed = seed;
+            header.base = 0;
+            if (!writeAll(fd, &header, sizeof(header)) || fdatasync(fd) != 0) {
+                cerr << "Error writing journal: " << filename << endl;
+                return false;
+            }
+            return true;
+        }
+
+        if (!readHeader(filename, header)) {
+            cerr << "Error: " << filename << " is not a version " << JOURNAL_VERSION
+                 << " scheduler journal; refusing to overwrite it" << endl;
+            return false;
+        }
+        size_t count = (info.st_size - sizeof(header)) / sizeof(JournalRecord);
+        records.resize(count);
+        if ((count > 0 && pread(fd, records.data(), count * sizeof(JournalRecord), sizeof(header)) !=
+                              (ssize_t)(count * sizeof(JournalRecord))) ||
+            ftruncate(fd, sizeof(header) + count * sizeof(JournalRecord)) != 0) {
+            cerr << "Error reading journal: " << filename << endl;
+            return false;
+        }
+        appended = durable = header.base + count;
+        return true;
+    }
+
+    uint64_t base() const { return header.base; }
+    uint64_t next() const { return appended; }
+
+    uint64_t append(JournalRecord record) {
+        lock_guard<mutex> guard(buffer_lock);
+        buffer.push_back(record);
+        return ++appended;
+    }
+
+    bool broken() const { return failed; }
+
+    bool sync(uint64_t sequence) {
+        lock_guard<mutex> flush(flush_lock);
+        if (durable >= sequence) return true;
+        if (failed) return false;
+        uint64_t target;
+        {
+            lock_guard<mutex> guard(buffer_lock);
+            flushing.swap(buffer);
+            target = appended;
+        }
+        if (!writeAll(fd, flushing.data(), flushing.size() * sizeof(JournalRecord)) || fdatasync(fd) != 0) {
+            failed = true;
+            unsynced.swap(flushing);
+            return false;
+        }
+        flushing.clear();
+        durable = target;
+        return true;
+    }
+
+    // Once broken: takes the records appended after the last durable one,
+    // oldest first, so the caller can undo them, and cuts off whatever part
+    // of them reached the file
+    vector<JournalRecord> discardUnsynced() {
+        lock_guard<mutex> flush(flush_lock);
+        lock_guard<mutex> guard(buffer_lock);
+        vector<JournalRecord> lost;
+        lost.swap(unsynced);
+        lost.insert(lost.end(), buffer.begin(), buffer.end());
+        buffer.clear();
+        appended = durable;
+        if (!lost.empty() && ftruncate(fd, sizeof(header) + (durable - header.base) * sizeof(JournalRecord)) != 0) {
+            cerr << "Warning: Could not cut unacknowledged records from journal " << path << endl;
+        }
+        return lost;
+    }
+
+    // Drops the records up to sequence once a snapshot holds them;
+    // numbering continues from there. Records appended since the snapshot
+    // was taken stay: those on disk move to the new file, which replaces the
+    // old one by rename so a crash leaves one or the other, and buffered
+    // ones are written by the next sync.
+    bool restart(uint64_t sequence) {
+        lock_guard<mutex> flush(flush_lock);
+        if (failed) return false;
+        uint64_t base = max(sequence, header.base);
+        vector<JournalRecord> kept(durable > base ? durable - base : 0);
+        if (!kept.empty() && pread(fd, kept.data(), kept.size() * sizeof(JournalRecord),
+                                   sizeof(header) + (base - header.base) * sizeof(JournalRecord)) !=
+                                 (ssize_t)(kept.size() * sizeof(JournalRecord))) {
+            return false;
+        }
+
+        JournalHeader restarted = header;
+        restarted.base = base;
+        string temporary = path + ".tmp";
+        int restarted_fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (restarted_fd < 0) return false;
+        if (!writeAll(restarted_fd, &restarted, sizeof(restarted)) ||
+            !writeAll(restarted_fd, kept.data(), kept.size() * sizeof(JournalRecord)) ||
+            fdatasync(restarted_fd) != 0 || rename(temporary.c_str(), path.c_str()) != 0) {
+            ::close(restarted_fd);
+            unlink(temporary.c_str());
+            return false;
+        }
+        ::close(fd);
+        fd = restarted_fd;
+        header = restarted;
+        {
+            // Buffered records the snapshot already holds are never written
+            lock_guard<mutex> guard(buffer_lock);
+            if (base > durable) buffer.erase(buffer.begin(), buffer.begin() + min<uint64_t>(buffer.size(), base - durable));
+            appended = max(appended, base);
+        }
+        durable = max(durable, base);
+        return syncDirectoryOf(path);
+    }
+};
+
+// Occupancy of the Monday-Friday week at half-hour resolution (5 x 48 slots).
+// Course meetings and student unavailable times are encoded once at load time
+// so a conflict check is a handful of AND instructions.
+struct WeekMask {
+    static constexpr int DAYS = 5;
+    static constexpr int SLOT_MINUTES = 30;
+    static constexpr int SLOTS_PER_DAY = 24 * 60 / SLOT_MINUTES;
+    static constexpr int WORDS = (DAYS * SLOTS_PER_DAY + 63) / 64;
+
+    uint64_t bits[WORDS] = {};
+
+    // Marks [start_minute, end_minute) on the given day, rounding outwards to
+    // whole slots so partially covered slots still count as occupied.
+    void setRange(int day, int start_minute, int end_minute) {
+        if (day < 0 || day >= DAYS || end_minute <= start_minute) return;
+        int first = max(start_minute, 0) / SLOT_MINUTES;
+        int last = min((end_minute + SLOT_MINUTES - 1) / SLOT_MINUTES, SLOTS_PER_DAY);
+        for (int slot = first; slot < last; slot++) {
+            int bit = day * SLOTS_PER_DAY + slot;
+            bits[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+
+    // Whether a range starts and ends on slot boundaries, so setRange marks
+    // exactly its minutes
+    static bool aligned(int start_minute, int end_minute) {
+        return start_minute % SLOT_MINUTES == 0 && end_minute % SLOT_MINUTES == 0;
+    }
+
+    bool empty() const {
+        uint64_t any = 0;
+        for (int i = 0; i < WORDS; i++) any |= bits[i];
+        return any == 0;
+    }
+
+    bool intersects(const WeekMask& other) const {
+        uint64_t common = 0;
+        for (int i = 0; i < WORDS; i++) common |= bits[i] & other.bits[i];
+        return common != 0;
+    }
+
+    WeekMask& operator|=(const WeekMask& other) {
+        for (int i = 0; i < WORDS; i++) bits[i] |= other.bits[i];
+        return *this;
+    }
+};
+
 struct TimeSlot {
-    string day;
-    string start_time;
-    string end_time;
+    string_view day;
+    string_view start_time;
+    string_view end_time;
     int duration_hours;
 
-    string toString() const {
-        return day + "_" + start_time + "-" + end_time;
+    // Parsed once at load time; day_index is -1 for days outside Monday-Friday
+    int day_index = -1;
+    int start_minute = 0;
+    int end_minute = 0;
+};
+
+// Marks a course or student reference that did not resolve to a dense index
+const uint32_t NO_INDEX = UINT32_MAX;
+
+// Interns identifier strings into dense indices in first-seen order, so the
+// scheduling core only ever compares and indexes integers
+class IdTable {
+private:
+    unordered_map<string_view, uint32_t> index;
+    deque<string> names;                    // stable storage the index keys view
+
+public:
+    uint32_t intern(string_view name) {
+        auto it = index.find(name);
+        if (it != index.end()) return it->second;
+        uint32_t id = names.size();
+        names.emplace_back(name);
+        index.emplace(names.back(), id);
+        return id;
+    }
+
+    uint32_t find(string_view name) const {
+        auto it = index.find(name);
+        return it == index.end() ? NO_INDEX : it->second;
+    }
+
+    const string& name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+};
+
+// Read-only view of a run of indices inside one of the flat index pools
+struct IndexRange {
+    const uint32_t* first;
+    const uint32_t* last;
+
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return last; }
+    size_t size() const { return last - first; }
+};
+
+// Fixed-size set of course indices, one bit per course
+struct CourseSet {
+    vector<uint64_t> words;
+
+    void resize(size_t course_count) { words.assign((course_count + 63) / 64, 0); }
+    void clear() { fill(words.begin(), words.end(), 0); }
+    bool test(uint32_t course) const { return (words[course / 64] >> (course % 64)) & 1; }
+    void set(uint32_t course) { words[course / 64] |= uint64_t(1) << (course % 64); }
+    void reset(uint32_t course) { words[course / 64] &= ~(uint64_t(1) << (course % 64)); }
+
+    void unionWith(const uint64_t* row) {
+        for (size_t i = 0; i < words.size(); i++) words[i] |= row[i];
+    }
+};
+
+// Square bit matrix packed row by row; row i is a CourseSet-compatible word array
+class BitMatrix {
+private:
+    size_t words_per_row = 0;
+    vector<uint64_t> bits;
+
+public:
+    void resize(size_t n) {
+        words_per_row = (n + 63) / 64;
+        bits.assign(n * words_per_row, 0);
+    }
+
+    const uint64_t* row(size_t i) const { return bits.data() + i * words_per_row; }
+    bool test(size_t i, size_t j) const { return (row(i)[j / 64] >> (j % 64)) & 1; }
+    void set(size_t i, size_t j) { bits[i * words_per_row + j / 64] |= uint64_t(1) << (j % 64); }
+};
+
+// Courses that still have a free seat during a greedy pass. Courses only
+// fill during a pass, so closing one links it to its successor, and next(c)
+// follows the links with path halving to the first open course at or after
+// c. Catalog walks then step over full courses instead of testing them.
+class OpenCourses {
+private:
+    vector<uint32_t> next_open;             // next_open[c] == c while c is open
+
+public:
+    // Opens every course; next(course_count) is the end marker
+    void reset(size_t course_count) {
+        next_open.resize(course_count + 1);
+        for (uint32_t c = 0; c <= course_count; c++) next_open[c] = c;
+    }
+
+    bool empty() const { return next_open.empty(); }
+
+    void close(uint32_t course) { next_open[course] = course + 1; }
+
+    uint32_t next(uint32_t course) {
+        while (next_open[course] != course) {
+            next_open[course] = next_open[next_open[course]];
+            course = next_open[course];
+        }
+        return course;
+    }
+};
+
+// Yields a student's preferred courses first, then the rest of the catalog in
+// catalog order, each course once. Candidates are produced lazily, so a student
+// who is satisfied early never touches the catalog. The membership set is
+// scratch reused across students; every thread scheduling students owns one.
+// A scope of disjoint course lists can stand in for the catalog.
+class CandidateOrder {
+private:
+    CourseSet seen;
+    vector<uint32_t> marked;                // courses set in seen, cleared by start
+    IndexRange preferred = {nullptr, nullptr};
+    const uint32_t* next_preferred = nullptr;
+    uint32_t next_course = 0;
+    uint32_t course_count = 0;
+    const vector<IndexRange>* scope = nullptr;
+    size_t scope_range = 0;
+    const uint32_t* next_in_scope = nullptr;
+    OpenCourses* open = nullptr;
+
+public:
+    CandidateOrder() = default;
+    explicit CandidateOrder(size_t count) { resize(count); }
+
+    void resize(size_t count) {
+        course_count = count;
+        seen.resize(count);
+    }
+
+    // With open, the catalog walk skips courses closed in it; candidates
+    // that are full would be turned down anyway
+    void start(IndexRange preferences, const vector<IndexRange>* fallback = nullptr, OpenCourses* open = nullptr) {
+        // Only the previous student's preferences can be marked. They are
+        // remembered by value: their storage may have moved since.
+        for (uint32_t course : marked) seen.reset(course);
+        marked.clear();
+        preferred = preferences;
+        next_preferred = preferences.begin();
+        next_course = 0;
+        scope = fallback;
+        this->open = open;
+        scope_range = 0;
+        next_in_scope = scope && !scope->empty() ? (*scope)[0].begin() : nullptr;
+    }
+
+    // Returns the next candidate course, or NO_INDEX when exhausted
+    uint32_t next() {
+        while (next_preferred != preferred.end()) {
+            uint32_t course = *next_preferred++;
+            if (!seen.test(course)) {
+                seen.set(course);
+                marked.push_back(course);
+                return course;
+            }
+        }
+        if (scope) {
+            while (scope_range < scope->size()) {
+                if (next_in_scope == (*scope)[scope_range].end()) {
+                    if (++scope_range < scope->size()) next_in_scope = (*scope)[scope_range].begin();
+                    continue;
+                }
+                uint32_t course = *next_in_scope++;
+                if (!seen.test(course)) return course;
+            }
+            return NO_INDEX;
+        }
+        while (next_course < course_count) {
+            uint32_t course = open ? open->next(next_course) : next_course;
+            if (course >= course_count) break;
+            next_course = course + 1;
+            if (!seen.test(course)) return course;
+        }
+        return NO_INDEX;
+    }
+};
+
+// Min-cost max-flow on a compressed sparse row graph, solved primal-dual:
+// each phase runs Dijkstra on reduced costs to advance the node potentials,
+// then pushes a blocking flow through the arcs whose reduced cost is zero,
+// Dinic-style. Arc costs must be non-negative. All arrays are kept between
+// solves so rebuilding a graph of similar size does not reallocate.
+class MinCostFlow {
+private:
+    struct PendingArc {
+        uint32_t from, to;
+        int capacity, cost;
+    };
+
+    static constexpr long long UNREACHED = numeric_limits<long long>::max();
+
+    uint32_t node_count = 0;
+    vector<PendingArc> pending;
+    vector<uint32_t> arc_of;                // pending arc -> forward arc
+
+    // Arcs of node u are first_arc[u] .. first_arc[u + 1]; arc a and
+    // reverse[a] form a residual pair
+    vector<uint32_t> first_arc;
+    vector<uint32_t> head;
+    vector<uint32_t> reverse;
+    vector<int> residual;
+    vector<int> cost;
+
+    vector<long long> potential;
+    vector<long long> distance;
+    vector<pair<long long, uint32_t>> heap;
+    vector<int> level;
+    vector<uint32_t> queue;
+    vector<uint32_t> current;
+    vector<uint32_t> path;
+
+    void build() {
+        first_arc.assign(node_count + 1, 0);
+        for (const auto& arc : pending) {
+            first_arc[arc.from + 1]++;
+            first_arc[arc.to + 1]++;
+        }
+        for (uint32_t u = 0; u < node_count; u++) first_arc[u + 1] += first_arc[u];
+
+        size_t arc_count = pending.size() * 2;
+        head.resize(arc_count);
+        reverse.resize(arc_count);
+        residual.resize(arc_count);
+        cost.resize(arc_count);
+        arc_of.resize(pending.size());
+        current.assign(first_arc.begin(), first_arc.end() - 1);
+        for (size_t i = 0; i < pending.size(); i++) {
+            const PendingArc& arc = pending[i];
+            uint32_t forward = current[arc.from]++;
+            uint32_t backward = current[arc.to]++;
+            head[forward] = arc.to;
+            head[backward] = arc.from;
+            reverse[forward] = backward;
+            reverse[backward] = forward;
+            residual[forward] = arc.capacity;
+            residual[backward] = 0;
+            cost[forward] = arc.cost;
+            cost[backward] = -arc.cost;
+            arc_of[i] = forward;
+        }
+    }
+
+    long long reducedCost(uint32_t from, uint32_t arc) const {
+        return cost[arc] + potential[from] - potential[head[arc]];
+    }
+
+    // Shortest reduced-cost distances from source, stopping once sink is
+    // settled; every node's potential then advances by min(distance, sink's)
+    bool advancePotentials(uint32_t source, uint32_t sink) {
+        distance.assign(node_count, UNREACHED);
+        distance[source] = 0;
+        heap.clear();
+        heap.push_back({0, source});
+        auto later = greater<pair<long long, uint32_t>>();
+        while (!heap.empty()) {
+            pop_heap(heap.begin(), heap.end(), later);
+            auto [d, u] = heap.back();
+            heap.pop_back();
+            if (d > distance[u]) continue;
+            if (u == sink) break;
+            for (uint32_t a = first_arc[u]; a < first_arc[u + 1]; a++) {
+                if (residual[a] <= 0) continue;
+                long long candidate = d + reducedCost(u, a);
+                if (candidate < distance[head[a]]) {
+                    distance[head[a]] = candidate;
+                    heap.push_back({candidate, head[a]});
+                    push_heap(heap.begin(), heap.end(), later);
+                }
+            }
+        }
+        if (distance[sink] == UNREACHED) return false;
+        for (uint32_t u = 0; u < node_count; u++) potential[u] += min(distance[u], distance[sink]);
+        return true;
+    }
+
+    bool admissible(uint32_t from, uint32_t arc) const {
+        return residual[arc] > 0 && reducedCost(from, arc) == 0 && level[head[arc]] == level[from] + 1;
+    }
+
+    // Breadth-first levels over zero reduced-cost arcs, so the blocking flow
+    // only follows a DAG even where zero-cost cycles exist
+    bool buildLevels(uint32_t source, uint32_t sink) {
+        level.assign(node_count, -1);
+        level[source] = 0;
+        queue.clear();
+        queue.push_back(source);
+        for (size_t i = 0; i < queue.size(); i++) {
+            uint32_t u = queue[i];
+            for (uint32_t a = first_arc[u]; a < first_arc[u + 1]; a++) {
+                if (residual[a] > 0 && level[head[a]] < 0 && reducedCost(u, a) == 0) {
+                    level[head[a]] = level[u] + 1;
+                    queue.push_back(head[a]);
+                }
+            }
+        }
+        return level[sink] >= 0;
+    }
+
+    // Iterative DFS with current-arc pointers; dead ends are cut from the
+    // level graph so each arc is retired at most once per blocking flow
+    long long blockingFlow(uint32_t source, uint32_t sink) {
+        current.assign(first_arc.begin(), first_arc.end() - 1);
+        long long pushed = 0;
+        path.clear();
+        uint32_t u = source;
+        while (true) {
+            if (u == sink) {
+                int bottleneck = numeric_limits<int>::max();
+                for (uint32_t a : path) bottleneck = min(bottleneck, residual[a]);
+                for (uint32_t a : path) {
+                    residual[a] -= bottleneck;
+                    residual[reverse[a]] += bottleneck;
+                }
+                pushed += bottleneck;
+                path.clear();
+                u = source;
+                continue;
+            }
+            uint32_t& a = current[u];
+            while (a < first_arc[u + 1] && !admissible(u, a)) a++;
+            if (a < first_arc[u + 1]) {
+                path.push_back(a);
+                u = head[a];
+                continue;
+            }
+            if (u == source) break;
+            level[u] = -1;
+            uint32_t back = path.back();
+            path.pop_back();
+            u = head[reverse[back]];
+            current[u]++;
+        }
+        return pushed;
+    }
+
+public:
+    void reset(uint32_t nodes) {
+        node_count = nodes;
+        pending.clear();
+    }
+
+    // Returns an id for flowOn
+    uint32_t addArc(uint32_t from, uint32_t to, int capacity, int arc_cost) {
+        pending.push_back({from, to, capacity, arc_cost});
+        return pending.size() - 1;
+    }
+
+    // Sends the maximum flow from source to sink at minimum total cost and
+    // returns the amount sent
+    long long solve(uint32_t source, uint32_t sink) {
+        build();
+        potential.assign(node_count, 0);
+        long long total = 0;
+        while (advancePotentials(source, sink)) {
+            while (buildLevels(source, sink)) total += blockingFlow(source, sink);
+        }
+        return total;
+    }
+
+    int flowOn(uint32_t id) const {
+        return residual[reverse[arc_of[id]]];
     }
 };
 
+// Text fields of courses and students are views into the mapped input files
 struct Course {
-    string id;
-    string name;
+    string_view id;
+    string_view name;
     int units;
     int max_students;
     vector<TimeSlot> time_slots;
-    string instructor;
-    string room;
-    vector<int> enrolled_students;
+    string_view instructor;
+    string_view room;
+    vector<uint32_t> enrolled_students;     // student indices
+
+    // Union of all meetings, built from time_slots at load time
+    WeekMask time_mask;
 };
 
 struct Student {
     int id;
-    string name;
+    string_view name;
     int min_units;
     int max_units;
-    vector<string> preferred_courses;
-    vector<string> unavailable_times;
+    // Preferred course indices live in Scheduler::Impl::preference_pool
+    uint32_t preference_begin = 0;
+    uint32_t preference_count = 0;
+    WeekMask unavailable_mask;
+    // Courses clashing with unavailable_mask, shared by every student with
+    // the same mask: a row of Scheduler::Impl::unavailable_blocked, or
+    // NO_INDEX before the equivalence classes are built
+    uint32_t unavailable_row = NO_INDEX;
 
     // Scheduling results
-    vector<string> assigned_courses;
+    vector<uint32_t> assigned_courses;      // course indices
     int total_units = 0;
+    int three_unit_count = 0;
+    int one_unit_count = 0;                 // every course that is not 3-unit
     bool scheduling_successful = false;
+
+    // Unavailable times plus the meetings of every assigned course
+    WeekMask occupied_mask;
+};
+
+// Compiled instance file: a header followed by 8-byte aligned sections of
+// fixed-size records that are used in place from a read-only mapping. IDs are
+// already interned (preferences hold course indices) and time masks are
+// pre-encoded. Bump INSTANCE_VERSION whenever a record layout changes.
+const char INSTANCE_MAGIC[8] = {'S', 'C', 'H', 'E', 'D', 'B', 'I', 'N'};
+const uint32_t INSTANCE_VERSION = 1;
+
+struct InstanceString {
+    uint64_t offset;                        // into the text section
+    uint64_t length;
+};
+
+struct InstanceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t week_mask_words;               // rejects files built with another WeekMask
+    uint64_t file_size;
+    uint64_t course_count, slot_count, student_count, preference_count, text_bytes;
+    uint64_t course_offset, slot_offset, student_offset, preference_offset, text_offset;
+};
+
+struct InstanceCourse {
+    InstanceString id, name, instructor, room;
+    int32_t units;
+    int32_t max_students;
+    uint32_t slot_begin;
+    uint32_t slot_count;
+    WeekMask time_mask;
+};
+
+struct InstanceSlot {
+    InstanceString day, start_time, end_time;
+    int32_t duration_hours;
+    int32_t day_index;
+    int32_t start_minute;
+    int32_t end_minute;
+};
+
+struct InstanceStudent {
+    InstanceString name;
+    int32_t id;
+    int32_t min_units;
+    int32_t max_units;
+    uint32_t preference_begin;
+    uint32_t preference_count;
+    uint32_t reserved;
+    WeekMask unavailable_mask;
+};
+
+static_assert(is_trivially_copyable<InstanceCourse>::value && is_trivially_copyable<InstanceStudent>::value,
+              "instance records are read in place");
+static_assert(sizeof(InstanceHeader) % 8 == 0 && sizeof(InstanceCourse) % 8 == 0 &&
+              sizeof(InstanceSlot) % 8 == 0 && sizeof(InstanceStudent) % 8 == 0,
+              "instance records keep 8-byte alignment");
+
+// Snapshot of every enrollment: the header, then 32-bit words for the output
+// order, success flags, courses per student and per course roster sizes and
+// capacities, then the assignments and the rosters in order. Rosters are kept
+// as they were so a restored schedule is written out byte for byte the same.
+const char SNAPSHOT_MAGIC[8] = {'S', 'C', 'H', 'E', 'D', 'S', 'N', 'P'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t sequence;                      // journal records the snapshot includes
+    uint64_t student_count, course_count, assignment_count;
+};
+
+// Problem found while parsing an input line, reported as
+// "<message> <line_number>: <detail>"; detail views the mapped input
+struct LoadDiagnostic {
+    const char* message;
+    int line_number;
+    string_view detail;
+};
+
+// Students parsed from one newline-aligned run of the students file. Line
+// numbers and preference symbols are local to the batch until it is merged.
+struct StudentBatch {
+    vector<Student> students;
+    vector<uint32_t> preference_pool;
+    IdTable course_symbols;
+    vector<LoadDiagnostic> diagnostics;
+    int line_count = 0;
+};
+
+// Counts of a streamed schedule, known only once the stream ends
+struct StreamTotals {
+    size_t streamed = 0;
+    size_t successful = 0;
+    size_t total_enrollments = 0;
+};
+
+// What a batch of events did: the schedules of the students it touched as
+// they were before their first change, and the counts for the log
+struct EventOutcome {
+    unordered_map<uint32_t, pair<vector<uint32_t>, bool>> before;
+    size_t applied = 0;
+    size_t refused = 0;
+    size_t replaced = 0;
+};
+
+// Per-thread scratch for greedy turns, reused across students
+struct TurnScratch {
+    CourseSet blocked;
+    CandidateOrder candidates;
+    vector<IndexRange> scope;
+
+    // Courses with free seats in the pass, where the pass tracks them
+    OpenCourses open;
+
+    // Scarcity order, filled in by the greedy pass before each turn:
+    // preferences and the catalog, least contended course first
+    bool ranked = false;
+    vector<uint32_t> ranked_preferences;
+    vector<IndexRange> ranked_catalog;
+};
+
+// Outcome of one greedy pass, kept apart from Student and Course so several
+// independently shuffled passes can run side by side. Courses a student gains
+// during their turn are contiguous in added_courses.
+struct GreedyPass {
+    uint32_t seed = 0;
+    vector<uint32_t> order;                 // students in scheduling order
+    vector<int> seats_taken;                // per course
+    vector<uint32_t> added_courses;
+    vector<uint32_t> added_begin;           // per student, into added_courses
+    vector<uint32_t> added_count;           // per student; up to every course
+    vector<uint8_t> successful;
+    size_t successful_count = 0;
+    size_t preference_hits = 0;             // assigned courses the student preferred
+    size_t enrollments = 0;
+    TurnScratch scratch;
+
+    // Scarcity order: demand still expected per course from students whose
+    // turn has not come, and the catalog ranked by demand over free seats,
+    // re-ranked every few turns
+    vector<float> demand;
+    vector<uint32_t> ranking;
+    size_t turns_since_ranking = 0;
+
+    // Per equivalence class, the last member whose turn ran in full, or
+    // NO_INDEX; later members replay it while its courses have seats
+    vector<uint32_t> class_reference;
+
+    // Ranks passes by scheduled students, then by preferred courses granted
+    bool betterThan(const GreedyPass& other) const {
+        if (successful_count != other.successful_count) return successful_count > other.successful_count;
+        return preference_hits > other.preference_hits;
+    }
+};
+
+// One enrollment change made by the improvement phase, kept so that a failed
+// attempt can be rolled back
+struct MoveRecord {
+    uint32_t student;
+    uint32_t course;
+    bool enrolled;                          // false for a drop
+};
+
+// Depth-first branch-and-bound state. Students are decided one at a time in
+// most-constrained-first order; placements change the occupancy masks,
+// counters and seat counts in place and are undone from the assignment log.
+struct ExactSearch {
+    vector<uint32_t> order;
+    vector<vector<uint32_t>> options;       // per student: courses clear of unavailable times, three-unit first
+    vector<int> demand;                     // three-unit courses still needed
+    vector<uint32_t> demand_counts;         // per position: students from there on with each demand
+    int max_demand = 0;
+    vector<WeekMask> occupied;
+    vector<int> total_units;
+    vector<int> three_units;
+    vector<int> one_units;
+    vector<int> free_seats;
+    long long free_three_seats = 0;
+
+    // (student, course) placements on the current path, and the occupancy
+    // each replaced
+    vector<pair<uint32_t, uint32_t>> assignment;
+    vector<WeekMask> previous_occupied;
+    vector<pair<uint32_t, uint32_t>> best_assignment;
+
+    size_t successes = 0;
+    size_t best = 0;
+    size_t nodes = 0;
+    size_t node_limit = 0;                  // 0 = unlimited
+    bool has_deadline = false;
+    chrono::steady_clock::time_point deadline;
+    bool stopped = false;
+    size_t open_bound = 0;                  // best bound among subtrees left unexplored
+};
+
+// One candidate of a capacity what-if batch and the schedule it leads to
+struct CapacityTrial {
+    uint32_t course;
+    int delta;                              // seats added, negative when removed
+    size_t change;                          // index into the changes evaluated
+    int capacity = 0;                       // max_students with the change
+    size_t scheduled = 0;
+    size_t displaced = 0;                   // enrollments the change took away
+};
+
+// The committed schedule as every what-if trial sees it. Courses full in it
+// stay full in a trial, except the changed one, so candidates are limited to
+// the open courses in catalog order.
+struct CapacityBase {
+    vector<uint32_t> unscheduled;           // in schedule order
+    size_t scheduled = 0;
+    vector<uint32_t> open_courses;
+    vector<uint8_t> open;                   // per course
+};
+
+// The schedule as daemon queries see it, published after every change.
+// A change copies the chunk of students and the roster it touches and shares
+// everything else with the previous copy, so queries never wait for writers.
+struct ServedSchedule {
+    static constexpr size_t CHUNK = 256;    // students per chunk
+    vector<shared_ptr<const vector<Student>>> student_chunks;
+    vector<shared_ptr<const vector<uint32_t>>> rosters;     // per course, student indices
+
+    const Student& student(uint32_t index) const { return (*student_chunks[index / CHUNK])[index % CHUNK]; }
 };
 
-class Scheduler {
+// Set by SIGINT and SIGTERM to stop the daemon; cleared when serving starts
+static volatile sig_atomic_t stop_requested = 0;
+
+static void requestStop(int) {
+    stop_requested = 1;
+}
+
+}  // namespace
+
+class Scheduler::Impl {
 private:
     vector<Student> students;
     vector<Course> courses;
-    unordered_map<string, Course*> course_map;
+    uint32_t seed;
     mt19937 rng;
 
-    vector<string> split(const string& str, char delimiter) {
-        vector<string> tokens;
-        stringstream ss(str);
-        string token;
-        while (getline(ss, token, delimiter)) {
-            if (!token.empty()) {
-                tokens.push_back(token);
+    // Progress messages; errors and warnings always go to cerr
+    ostream* log = &cout;
+    ostream silent{nullptr};
+
+    // Input files stay mapped, and input passed in memory stays owned, for
+    // the scheduler's lifetime
+    vector<MappedFile> input_files;
+    deque<string> input_texts;
+
+    // Independent greedy passes per scheduleStudents call; the best is kept
+    size_t start_count = 1;
+
+    Engine engine = Engine::Greedy;
+
+    // Flow engine: a preferred course costs its rank in the student's list,
+    // any other course more than every preference. Each student also gets a
+    // few arcs to non-preferred courses, and conflicting allocations are
+    // repaired and re-flowed for a bounded number of rounds.
+    static constexpr int FLOW_MISS_COST = 16;
+    static constexpr size_t FLOW_FALLBACK_ARCS = 4;
+    static constexpr int FLOW_ROUNDS = 16;
+    MinCostFlow seat_flow;
+
+    // Students per task in the concurrent engine and in a draft round's
+    // proposal phase
+    static constexpr size_t CONCURRENT_BATCH = 2048;
+
+    // Exact engine limits; the node limit keeps the default run bounded
+    size_t exact_node_limit = 10000000;
+    double exact_time_limit_ms = 0;
+
+    // Wall-clock budget for the local-search phase after the greedy pass
+    double improve_budget_ms = 0;
+    vector<MoveRecord> move_log;
+
+    // Holders tried when an ejection chain needs a seat in a full course,
+    // and how many courses deep a chain may go
+    static constexpr size_t EJECTION_SAMPLE = 8;
+    static constexpr int EJECTION_DEPTH = 3;
+
+    // Daemon: requests that change enrollments take the lock and publish a
+    // new served copy; queries only load the current one. Connections past
+    // DAEMON_MAX_CONNECTIONS wait in the listen backlog.
+    mutex state_mutex;
+    shared_ptr<const ServedSchedule> served;    // atomic_load and atomic_store only
+    static constexpr size_t DAEMON_MAX_LINE = 4096;
+    static constexpr int DAEMON_POLL_MS = 200;
+    static constexpr size_t DAEMON_MAX_CONNECTIONS = 256;
+
+    // Crash safety: <path>.snap holds the last checkpoint and <path>.wal the
+    // daemon's changes since, each synced before it is acknowledged. A
+    // checkpoint is taken after scheduling, every JOURNAL_CHECKPOINT_RECORDS
+    // changes and at shutdown.
+    unique_ptr<Journal> journal;
+    string journal_path;
+    atomic<bool> checkpoint_running{false};
+    static constexpr uint64_t JOURNAL_CHECKPOINT_RECORDS = 1 << 20;
+
+    // Journal records found without a snapshot, replayed by the first
+    // checkpoint onto the schedule built again from the journal's seed
+    vector<JournalRecord> unreplayed;
+
+    // Worker threads for parallel phases, created on first use
+    size_t thread_count = 1;
+    unique_ptr<ThreadPool> pool;
+
+    // Students files at least this large are parsed in parallel chunks
+    static constexpr size_t PARALLEL_LOAD_MIN_BYTES = 1 << 20;
+    static constexpr size_t LOAD_CHUNK_MIN_BYTES = 256 << 10;
+
+    // Streamed SUMMARY values are padded to this width and filled in last
+    static constexpr int STREAM_FIELD_WIDTH = 40;
+
+    // The streaming preference pool is compacted once it holds this many
+    // entries per window student (room for dead entries of students that
+    // already left at about 8 preferences each), or the floor for tiny windows
+    static constexpr size_t STREAM_POOL_ENTRIES_PER_SLOT = 4 * 8;
+    static constexpr size_t STREAM_POOL_MIN_ENTRIES = 4096;
+
+    ThreadPool& workerPool() {
+        if (!pool) pool.reset(new ThreadPool(thread_count));
+        return *pool;
+    }
+
+    // Course identifiers seen in either input file; a preference is stored as
+    // its symbol until the courses file has been read, then as a course index
+    IdTable course_symbols;
+    vector<uint32_t> course_of_symbol;
+    vector<uint32_t> preference_pool;
+    size_t resolved_students = 0;
+
+    // Order in which students are scheduled and written out
+    vector<uint32_t> student_order;
+
+    // course_conflicts(i, j) is set when courses i and j meet at overlapping
+    // times; the diagonal is always set so an enrolled course blocks itself
+    BitMatrix course_conflicts;
+
+    // Departments are the alphabetic prefix of a course ID (MATH of MATH301);
+    // department d's courses are department_courses[department_begin[d] ..
+    // department_begin[d + 1]]
+    vector<uint32_t> department_of_course;
+    vector<uint32_t> department_courses;
+    vector<uint32_t> department_begin;
+    CandidateScope candidate_scope = CandidateScope::Catalog;
+
+    // Scarcity order: a student's weight on each preferred course that fits
+    // their unavailable times is the share of those courses they need, so
+    // per-course demand estimates the seats that will be asked of it. The
+    // catalog ranking is refreshed every SCARCITY_RERANK turns.
+    StudentOrder student_ordering = StudentOrder::Shuffle;
+    static constexpr size_t SCARCITY_RERANK = 256;
+
+    // Students with the same unit range, preference list and unavailable
+    // times take the same greedy turn from the same seats, so greedy passes
+    // schedule them per class; built before the first scheduling run
+    vector<uint32_t> student_class;
+    size_t class_count = 0;
+    vector<uint64_t> unavailable_blocked;   // rows of CourseSet words
+
+    void buildDepartments() {
+        IdTable names;
+        department_of_course.resize(courses.size());
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            string_view id = courses[c].id;
+            size_t length = 0;
+            while (length < id.size() && isalpha((unsigned char)id[length])) length++;
+            department_of_course[c] = names.intern(id.substr(0, length));
+        }
+        department_begin.assign(names.size() + 1, 0);
+        for (uint32_t d : department_of_course) department_begin[d + 1]++;
+        for (size_t d = 0; d < names.size(); d++) department_begin[d + 1] += department_begin[d];
+        department_courses.resize(courses.size());
+        vector<uint32_t> fill(department_begin.begin(), department_begin.end() - 1);
+        for (uint32_t c = 0; c < courses.size(); c++) department_courses[fill[department_of_course[c]]++] = c;
+    }
+
+    IndexRange departmentCourses(uint32_t department) const {
+        const uint32_t* base = department_courses.data();
+        return {base + department_begin[department], base + department_begin[department + 1]};
+    }
+
+    // Fallback course lists for a student under the department scope: each
+    // department of a preferred course once, in preference order
+    void departmentScope(const Student& student, vector<IndexRange>& scope) const {
+        scope.clear();
+        for (uint32_t c : preferences(student)) {
+            IndexRange range = departmentCourses(department_of_course[c]);
+            bool listed = false;
+            for (const auto& existing : scope) listed = listed || existing.begin() == range.begin();
+            if (!listed) scope.push_back(range);
+        }
+    }
+
+    void buildConflictMatrix() {
+        course_conflicts.resize(courses.size());
+        for (size_t i = 0; i < courses.size(); i++) {
+            course_conflicts.set(i, i);
+            for (size_t j = i + 1; j < courses.size(); j++) {
+                if (courses[i].time_mask.intersects(courses[j].time_mask)) {
+                    course_conflicts.set(i, j);
+                    course_conflicts.set(j, i);
+                }
+            }
+        }
+    }
+
+    // Starts a student's blocked set: every course clashing with their
+    // unavailable times or with a course they already hold
+    void initBlockedCourses(const Student& student, CourseSet& blocked) const {
+        blocked.clear();
+        for (uint32_t assigned : student.assigned_courses) {
+            blocked.unionWith(course_conflicts.row(assigned));
+        }
+        if (student.unavailable_mask.empty()) return;
+        if (student.unavailable_row != NO_INDEX) {
+            blocked.unionWith(unavailable_blocked.data() + student.unavailable_row * blocked.words.size());
+            return;
+        }
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            if (student.unavailable_mask.intersects(courses[c].time_mask)) blocked.set(c);
+        }
+    }
+
+    // Calls handle(line, line_number) for every line of text, without the
+    // line terminator
+    template <typename Handler>
+    static void forEachLine(string_view text, Handler handle) {
+        int line_number = 0;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t end = text.find('\n', pos);
+            if (end == string_view::npos) end = text.size();
+            string_view line = text.substr(pos, end - pos);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            handle(line, ++line_number);
+            pos = end + 1;
+        }
+    }
+
+    // forEachLine over a stream, read a line at a time
+    template <typename Handler>
+    static void forEachLine(istream& stream, Handler handle) {
+        int line_number = 0;
+        string line;
+        while (getline(stream, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            handle(string_view(line), ++line_number);
+        }
+    }
+
+    // Splits line into delimiter-separated fields, keeping empty ones, and
+    // returns how many there are; at most max_fields are stored
+    static size_t splitFields(string_view line, char delimiter, string_view* fields, size_t max_fields) {
+        size_t count = 0;
+        size_t pos = 0;
+        while (true) {
+            size_t end = line.find(delimiter, pos);
+            if (end == string_view::npos) end = line.size();
+            if (count < max_fields) fields[count] = line.substr(pos, end - pos);
+            count++;
+            if (end == line.size()) return count;
+            pos = end + 1;
+        }
+    }
+
+    // Calls handle(token) for every non-empty token of a delimited list
+    template <typename Handler>
+    static void forEachToken(string_view list, char delimiter, Handler handle) {
+        size_t pos = 0;
+        while (pos <= list.size()) {
+            size_t end = list.find(delimiter, pos);
+            if (end == string_view::npos) end = list.size();
+            if (end > pos) handle(list.substr(pos, end - pos));
+            pos = end + 1;
+        }
+    }
+
+    // Parses a leading integer the way stoi does, without building a string
+    static bool parseInt(string_view text, int& value) {
+        size_t pos = 0;
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) pos++;
+        if (pos < text.size() && text[pos] == '+') pos++;
+        auto result = from_chars(text.data() + pos, text.data() + text.size(), value);
+        return result.ec == errc();
+    }
+
+    // Parses "HH:MM" into minutes since midnight, or -1 if malformed
+    static int parseClockMinutes(string_view time) {
+        if (time.length() != 5 || time[2] != ':') return -1;
+        for (int i : {0, 1, 3, 4}) {
+            if (time[i] < '0' || time[i] > '9') return -1;
+        }
+        int hours = (time[0] - '0') * 10 + (time[1] - '0');
+        int minutes = (time[3] - '0') * 10 + (time[4] - '0');
+        if (hours > 24 || minutes > 59) return -1;
+        return hours * 60 + minutes;
+    }
+
+    static int dayIndex(string_view day) {
+        static const char* const DAY_NAMES[WeekMask::DAYS] = {
+            "Monday", "Tuesday", "Wednesday", "Thursday", "Friday"
+        };
+        for (int i = 0; i < WeekMask::DAYS; i++) {
+            if (day == DAY_NAMES[i]) return i;
+        }
+        return -1;
+    }
+
+    // Fills day and times of slot from "Day_HH:MM-HH:MM"; false if malformed
+    static bool parseTimeRange(string_view range_str, TimeSlot& slot) {
+        size_t underscore_pos = range_str.find('_');
+        if (underscore_pos == string_view::npos) return false;
+        size_t dash_pos = range_str.find('-', underscore_pos);
+        if (dash_pos == string_view::npos) return false;
+
+        string_view start_time = range_str.substr(underscore_pos + 1, dash_pos - underscore_pos - 1);
+        string_view end_time = range_str.substr(dash_pos + 1);
+        int start_minute = parseClockMinutes(start_time);
+        int end_minute = parseClockMinutes(end_time);
+        if (start_minute < 0 || end_minute < 0) return false;
+
+        slot.day = range_str.substr(0, underscore_pos);
+        slot.start_time = start_time;
+        slot.end_time = end_time;
+        slot.day_index = dayIndex(slot.day);
+        slot.start_minute = start_minute;
+        slot.end_minute = end_minute;
+        return true;
+    }
+
+    // Rewrites the preferences of students loaded since the last call from
+    // course symbols to course indices, dropping courses not in the catalog
+    void resolvePreferences() {
+        if (courses.empty() || resolved_students == students.size()) return;
+
+        size_t write = resolved_students == 0 ? 0 :
+            students[resolved_students - 1].preference_begin + students[resolved_students - 1].preference_count;
+        for (size_t i = resolved_students; i < students.size(); i++) {
+            Student& student = students[i];
+            uint32_t begin = student.preference_begin;
+            student.preference_begin = write;
+            for (uint32_t j = begin; j < begin + student.preference_count; j++) {
+                uint32_t symbol = preference_pool[j];
+                uint32_t course = symbol < course_of_symbol.size() ? course_of_symbol[symbol] : NO_INDEX;
+                if (course != NO_INDEX) preference_pool[write++] = course;
             }
+            student.preference_count = write - student.preference_begin;
         }
-        return tokens;
+        preference_pool.resize(write);
+        resolved_students = students.size();
     }
 
-    TimeSlot parseTimeSlot(const string& slot_str) {
+    TimeSlot parseTimeSlot(string_view slot_str) {
         TimeSlot slot;
+        slot.duration_hours = 1;
 
-        try {
-            size_t colon_pos = slot_str.find(':');
-            if (colon_pos == string::npos) {
-                cerr << "Warning: Invalid time slot format (no colon): " << slot_str << endl;
-                slot.day = "Monday";
-                slot.start_time = "08:00";
-                slot.end_time = "09:00";
+        // "Day_HH:MM-HH:MM:duration" - the duration follows the third colon
+        string_view range_str = slot_str;
+        if (count(slot_str.begin(), slot_str.end(), ':') >= 3) {
+            size_t colon_pos = slot_str.rfind(':');
+            range_str = slot_str.substr(0, colon_pos);
+            if (!parseInt(slot_str.substr(colon_pos + 1), slot.duration_hours)) {
+                cerr << "Warning: Invalid duration in time slot: " << slot_str << endl;
                 slot.duration_hours = 1;
-                return slot;
             }
+        }
+
+        if (!parseTimeRange(range_str, slot)) {
+            cerr << "Warning: Invalid time slot format: " << slot_str << endl;
+            // Provide safe defaults
+            slot.day = "Monday";
+            slot.start_time = "08:00";
+            slot.end_time = "09:00";
+            slot.day_index = 0;
+            slot.start_minute = 8 * 60;
+            slot.end_minute = 9 * 60;
+        } else if (slot.day_index < 0) {
+            cerr << "Warning: Time slot outside Monday-Friday ignored for conflicts: " << slot_str << endl;
+        } else if (!WeekMask::aligned(slot.start_minute, slot.end_minute)) {
+            cerr << "Warning: Widening time slot to whole half-hours for conflicts: " << slot_str << endl;
+        }
+
+        return slot;
+    }
+
+public:
+    Impl() : Impl(random_device{}()) {}
+    explicit Impl(uint32_t seed) : seed(seed), rng(seed) {}
+
+    // Seed of the shuffle; rerunning with the same seed and input reproduces
+    // the schedule exactly
+    uint32_t randomSeed() const { return seed; }
+
+    void setLog(ostream* stream) {
+        log = stream ? stream : &silent;
+    }
+
+    // Threads used by parallel phases such as chunked loading; 0 selects
+    // one per hardware thread
+    void setThreadCount(size_t count) {
+        thread_count = count == 0 ? max(1u, thread::hardware_concurrency()) : count;
+        pool.reset();
+    }
+
+    // Parses one record of a students file. The student's name views line,
+    // so it lives as long as the text line points into. Preferred course IDs
+    // are interned in symbols and their symbol numbers appended to pool.
+    // Comments and blank lines yield false without a diagnostic.
+    static bool parseStudentLine(string_view line, int line_number, Student& student, vector<uint32_t>& pool,
+                                 IdTable& symbols, vector<LoadDiagnostic>& diagnostics) {
+        // Skip comments and empty lines
+        if (line.empty() || line[0] == '#') return false;
+
+        string_view parts[6];
+        if (splitFields(line, '|', parts, 6) != 6) {
+            diagnostics.push_back({"Warning: Skipping malformed line", line_number, line});
+            return false;
+        }
+
+        student.name = parts[1];
+        if (!parseInt(parts[0], student.id) || !parseInt(parts[2], student.min_units) ||
+            !parseInt(parts[3], student.max_units)) {
+            diagnostics.push_back({"Error parsing student on line", line_number, "invalid number"});
+            return false;
+        }
+
+        // Parse preferred courses
+        student.preference_begin = pool.size();
+        forEachToken(parts[4], ',', [&](string_view course_id) {
+            pool.push_back(symbols.intern(course_id));
+            student.preference_count++;
+        });
+
+        // Parse unavailable times
+        forEachToken(parts[5], ',', [&](string_view unavailable) {
+            TimeSlot slot;
+            if (!parseTimeRange(unavailable, slot)) {
+                diagnostics.push_back({"Warning: Ignoring invalid unavailable time on line",
+                                       line_number, unavailable});
+                return;
+            }
+            if (!WeekMask::aligned(slot.start_minute, slot.end_minute)) {
+                diagnostics.push_back({"Warning: Widening unavailable time to whole half-hours on line",
+                                       line_number, unavailable});
+            }
+            student.unavailable_mask.setRange(slot.day_index, slot.start_minute, slot.end_minute);
+        });
+        student.occupied_mask = student.unavailable_mask;
+        return true;
+    }
+
+    // Parses the lines of text into batch; safe to run concurrently on
+    // separate batches
+    static void parseStudentLines(string_view text, StudentBatch& batch) {
+        forEachLine(text, [&](string_view line, int line_number) {
+            batch.line_count = line_number;
+            Student student;
+            if (parseStudentLine(line, line_number, student, batch.preference_pool, batch.course_symbols,
+                                 batch.diagnostics)) {
+                batch.students.push_back(student);
+            }
+        });
+    }
+
+    // Appends a batch in file order: reports its diagnostics with file line
+    // numbers and translates its preference symbols to the scheduler's own
+    void mergeStudentBatch(StudentBatch& batch, int first_line) {
+        for (const auto& diagnostic : batch.diagnostics) {
+            cerr << diagnostic.message << " " << (first_line + diagnostic.line_number) << ": "
+                 << diagnostic.detail << endl;
+        }
+
+        vector<uint32_t> symbol_map(batch.course_symbols.size());
+        for (uint32_t local = 0; local < symbol_map.size(); local++) {
+            symbol_map[local] = course_symbols.intern(batch.course_symbols.name(local));
+        }
+
+        uint32_t pool_offset = preference_pool.size();
+        for (uint32_t local : batch.preference_pool) preference_pool.push_back(symbol_map[local]);
+        for (auto& student : batch.students) {
+            student.preference_begin += pool_offset;
+            students.push_back(student);
+        }
+    }
+
+    bool loadStudents(const string& filename) {
+        MappedFile file;
+        if (!file.open(filename)) {
+            cerr << "Error opening students file: " << filename << endl;
+            return false;
+        }
+        string_view text = file.view();
+        input_files.push_back(move(file));
+        return parseStudentsText(text);
+    }
+
+    // Students in the text file format, held in memory for the scheduler's
+    // lifetime by input_files or input_texts
+    bool parseStudentsText(string_view text) {
+        // Cut the file into newline-aligned chunks; small files or a single
+        // thread parse as one chunk
+        vector<string_view> chunks;
+        size_t chunk_count = 1;
+        if (thread_count > 1 && text.size() >= PARALLEL_LOAD_MIN_BYTES) {
+            chunk_count = min(thread_count * 4, text.size() / LOAD_CHUNK_MIN_BYTES);
+        }
+        size_t chunk_begin = 0;
+        for (size_t i = 1; i <= chunk_count && chunk_begin < text.size(); i++) {
+            size_t chunk_end = text.size();
+            if (i < chunk_count) {
+                chunk_end = text.find('\n', max(chunk_begin, text.size() / chunk_count * i));
+                chunk_end = chunk_end == string_view::npos ? text.size() : chunk_end + 1;
+            }
+            chunks.push_back(text.substr(chunk_begin, chunk_end - chunk_begin));
+            chunk_begin = chunk_end;
+        }
+
+        vector<StudentBatch> batches(chunks.size());
+        if (chunks.size() == 1) {
+            parseStudentLines(chunks[0], batches[0]);
+        } else {
+            ThreadPool& workers = workerPool();
+            for (size_t i = 0; i < chunks.size(); i++) {
+                workers.submit([&, i] { parseStudentLines(chunks[i], batches[i]); });
+            }
+            workers.wait();
+        }
+
+        int first_line = 0;
+        for (auto& batch : batches) {
+            mergeStudentBatch(batch, first_line);
+            first_line += batch.line_count;
+            batch = StudentBatch();
+        }
+        return studentsAdded();
+    }
+
+    // Puts students appended since the last load in order and resolves
+    // their preferences
+    bool studentsAdded() {
+        while (student_order.size() < students.size()) student_order.push_back(student_order.size());
+        resolvePreferences();
+
+        *log << "Loaded " << students.size() << " students" << endl;
+        return true;
+    }
+
+    // Appends a record's text field to buffer, whose capacity was reserved
+    // for every field so earlier views stay valid, and returns a view of it
+    static string_view keepText(string& buffer, const string& field) {
+        size_t offset = buffer.size();
+        buffer += field;
+        return string_view(buffer).substr(offset, field.size());
+    }
+
+    // Students built directly from records: fields are taken as they are,
+    // so names may hold the file format's separators, and empty list items
+    // are skipped as in a file
+    bool loadStudents(const vector<StudentRecord>& records) {
+        size_t text_size = 0;
+        for (const auto& record : records) text_size += record.name.size();
+        string& text = input_texts.emplace_back();
+        text.reserve(text_size);
+
+        for (size_t i = 0; i < records.size(); i++) {
+            const StudentRecord& record = records[i];
+            Student student;
+            student.id = record.id;
+            student.name = keepText(text, record.name);
+            student.min_units = record.min_units;
+            student.max_units = record.max_units;
+
+            student.preference_begin = preference_pool.size();
+            for (const auto& course_id : record.preferred_courses) {
+                if (course_id.empty()) continue;
+                preference_pool.push_back(course_symbols.intern(course_id));
+                student.preference_count++;
+            }
+            for (const auto& unavailable : record.unavailable_times) {
+                TimeSlot slot;
+                if (unavailable.empty()) continue;
+                if (!parseTimeRange(unavailable, slot)) {
+                    cerr << "Warning: Ignoring invalid unavailable time of student record " << i + 1 << ": "
+                         << unavailable << endl;
+                    continue;
+                }
+                if (!WeekMask::aligned(slot.start_minute, slot.end_minute)) {
+                    cerr << "Warning: Widening unavailable time to whole half-hours of student record " << i + 1
+                         << ": " << unavailable << endl;
+                }
+                student.unavailable_mask.setRange(slot.day_index, slot.start_minute, slot.end_minute);
+            }
+            student.occupied_mask = student.unavailable_mask;
+            students.push_back(student);
+        }
+        return studentsAdded();
+    }
+
+    bool loadCourses(const string& filename) {
+        MappedFile file;
+        if (!file.open(filename)) {
+            cerr << "Error opening courses file: " << filename << endl;
+            return false;
+        }
+        string_view text = file.view();
+        input_files.push_back(move(file));
+        return parseCoursesText(text);
+    }
+
+    bool loadStudentsText(string text) {
+        input_texts.push_back(move(text));
+        return parseStudentsText(input_texts.back());
+    }
+
+    bool loadCoursesText(string text) {
+        input_texts.push_back(move(text));
+        return parseCoursesText(input_texts.back());
+    }
+
+    bool parseCoursesText(string_view text) {
+        forEachLine(text, [&](string_view line, int line_number) {
+            // Skip comments and empty lines
+            if (line.empty() || line[0] == '#') return;
+
+            string_view parts[7];
+            if (splitFields(line, '|', parts, 7) != 7) {
+                cerr << "Warning: Skipping malformed course line " << line_number << ": " << line << endl;
+                return;
+            }
+
+            Course course;
+            course.id = parts[0];
+            course.name = parts[1];
+            course.instructor = parts[4];
+            course.room = parts[5];
+            if (!parseInt(parts[2], course.units) || !parseInt(parts[3], course.max_students)) {
+                cerr << "Error parsing course on line " << line_number << ": invalid number" << endl;
+                return;
+            }
+
+            // Parse time slots
+            forEachToken(parts[6], ',', [&](string_view slot_str) {
+                course.time_slots.push_back(parseTimeSlot(slot_str));
+            });
+            addCourse(move(course));
+        });
+        return coursesAdded();
+    }
+
+    // Courses built directly from records, like loadStudents(records)
+    bool loadCourses(const vector<CourseRecord>& records) {
+        size_t text_size = 0;
+        for (const auto& record : records) {
+            text_size += record.id.size() + record.name.size() + record.instructor.size() + record.room.size();
+            for (const auto& slot : record.time_slots) text_size += slot.size();
+        }
+        string& text = input_texts.emplace_back();
+        text.reserve(text_size);
+
+        for (const auto& record : records) {
+            Course course;
+            course.id = keepText(text, record.id);
+            course.name = keepText(text, record.name);
+            course.units = record.units;
+            course.max_students = record.max_students;
+            course.instructor = keepText(text, record.instructor);
+            course.room = keepText(text, record.room);
+            for (const auto& slot : record.time_slots) {
+                if (!slot.empty()) course.time_slots.push_back(parseTimeSlot(keepText(text, slot)));
+            }
+            addCourse(move(course));
+        }
+        return coursesAdded();
+    }
+
+    void addCourse(Course&& course) {
+        for (const auto& slot : course.time_slots) {
+            course.time_mask.setRange(slot.day_index, slot.start_minute, slot.end_minute);
+        }
+        courses.push_back(move(course));
+    }
+
+    // Indexes the catalog once courses have been appended
+    bool coursesAdded() {
+        // Map every course symbol to its index; a repeated ID resolves to
+        // the last course declared with it
+        for (size_t i = 0; i < courses.size(); i++) {
+            uint32_t symbol = course_symbols.intern(courses[i].id);
+            if (symbol >= course_of_symbol.size()) course_of_symbol.resize(symbol + 1, NO_INDEX);
+            course_of_symbol[symbol] = i;
+        }
+        resolvePreferences();
+        buildConflictMatrix();
+        buildDepartments();
+
+        *log << "Loaded " << courses.size() << " courses" << endl;
+        return true;
+    }
+
+    // Writes the loaded students and courses as a compiled instance file
+    bool saveInstance(const string& filename) {
+        resolvePreferences();
+
+        InstanceHeader header = {};
+        memcpy(header.magic, INSTANCE_MAGIC, sizeof(header.magic));
+        header.version = INSTANCE_VERSION;
+        header.week_mask_words = WeekMask::WORDS;
+
+        string text;
+        auto addText = [&text](string_view value) {
+            InstanceString ref = {text.size(), value.size()};
+            text.append(value.data(), value.size());
+            return ref;
+        };
+
+        vector<InstanceCourse> course_records;
+        vector<InstanceSlot> slot_records;
+        for (const auto& course : courses) {
+            InstanceCourse record = {};
+            record.id = addText(course.id);
+            record.name = addText(course.name);
+            record.instructor = addText(course.instructor);
+            record.room = addText(course.room);
+            record.units = course.units;
+            record.max_students = course.max_students;
+            record.slot_begin = slot_records.size();
+            record.slot_count = course.time_slots.size();
+            record.time_mask = course.time_mask;
+            for (const auto& slot : course.time_slots) {
+                InstanceSlot slot_record = {};
+                slot_record.day = addText(slot.day);
+                slot_record.start_time = addText(slot.start_time);
+                slot_record.end_time = addText(slot.end_time);
+                slot_record.duration_hours = slot.duration_hours;
+                slot_record.day_index = slot.day_index;
+                slot_record.start_minute = slot.start_minute;
+                slot_record.end_minute = slot.end_minute;
+                slot_records.push_back(slot_record);
+            }
+            course_records.push_back(record);
+        }
+
+        vector<InstanceStudent> student_records;
+        student_records.reserve(students.size());
+        for (const auto& student : students) {
+            InstanceStudent record = {};
+            record.name = addText(student.name);
+            record.id = student.id;
+            record.min_units = student.min_units;
+            record.max_units = student.max_units;
+            record.preference_begin = student.preference_begin;
+            record.preference_count = student.preference_count;
+            record.unavailable_mask = student.unavailable_mask;
+            student_records.push_back(record);
+        }
+
+        auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+        header.course_count = course_records.size();
+        header.slot_count = slot_records.size();
+        header.student_count = student_records.size();
+        header.preference_count = preference_pool.size();
+        header.text_bytes = text.size();
+        header.course_offset = sizeof(InstanceHeader);
+        header.slot_offset = header.course_offset + course_records.size() * sizeof(InstanceCourse);
+        header.student_offset = header.slot_offset + slot_records.size() * sizeof(InstanceSlot);
+        header.preference_offset = header.student_offset + student_records.size() * sizeof(InstanceStudent);
+        header.text_offset = align(header.preference_offset + preference_pool.size() * sizeof(uint32_t));
+        header.file_size = header.text_offset + text.size();
+
+        ofstream file(filename, ios::binary);
+        if (!file.is_open()) {
+            cerr << "Error opening instance file for writing: " << filename << endl;
+            return false;
+        }
+        auto writeBytes = [&file](const void* data, size_t size) {
+            file.write(static_cast<const char*>(data), size);
+        };
+        writeBytes(&header, sizeof(header));
+        writeBytes(course_records.data(), course_records.size() * sizeof(InstanceCourse));
+        writeBytes(slot_records.data(), slot_records.size() * sizeof(InstanceSlot));
+        writeBytes(student_records.data(), student_records.size() * sizeof(InstanceStudent));
+        writeBytes(preference_pool.data(), preference_pool.size() * sizeof(uint32_t));
+        static const char padding[8] = {};
+        writeBytes(padding, header.text_offset - (header.preference_offset + preference_pool.size() * sizeof(uint32_t)));
+        writeBytes(text.data(), text.size());
+        file.close();
+        if (!file) {
+            cerr << "Error writing instance file: " << filename << endl;
+            return false;
+        }
+
+        *log << "Compiled " << students.size() << " students and " << courses.size()
+             << " courses into " << filename << endl;
+        return true;
+    }
+
+    static bool isInstanceFile(const string& filename) {
+        ifstream file(filename, ios::binary);
+        char magic[sizeof(INSTANCE_MAGIC)] = {};
+        file.read(magic, sizeof(magic));
+        return file && memcmp(magic, INSTANCE_MAGIC, sizeof(magic)) == 0;
+    }
+
+    // Loads a compiled instance in place of loadStudents + loadCourses. Names
+    // and IDs stay as views into the mapping; no per-record allocation is made
+    // beyond each course's time slot list.
+    bool loadInstance(const string& filename) {
+        if (!students.empty() || !courses.empty()) {
+            cerr << "Error: an instance must be loaded into an empty scheduler" << endl;
+            return false;
+        }
+
+        MappedFile file;
+        if (!file.open(filename)) {
+            cerr << "Error opening instance file: " << filename << endl;
+            return false;
+        }
+        string_view data = file.view();
+
+        InstanceHeader header;
+        if (data.size() < sizeof(header)) {
+            cerr << "Error: truncated instance file: " << filename << endl;
+            return false;
+        }
+        memcpy(&header, data.data(), sizeof(header));
+        if (memcmp(header.magic, INSTANCE_MAGIC, sizeof(header.magic)) != 0) {
+            cerr << "Error: not a compiled instance file: " << filename << endl;
+            return false;
+        }
+        if (header.version != INSTANCE_VERSION || header.week_mask_words != WeekMask::WORDS) {
+            cerr << "Error: instance file " << filename << " has version " << header.version
+                 << ", expected " << INSTANCE_VERSION << "; recompile it" << endl;
+            return false;
+        }
+
+        auto sectionFits = [&](uint64_t offset, uint64_t count, uint64_t record_size) {
+            return offset % 8 == 0 && offset <= data.size() && count <= (data.size() - offset) / record_size;
+        };
+        if (header.file_size != data.size() ||
+            !sectionFits(header.course_offset, header.course_count, sizeof(InstanceCourse)) ||
+            !sectionFits(header.slot_offset, header.slot_count, sizeof(InstanceSlot)) ||
+            !sectionFits(header.student_offset, header.student_count, sizeof(InstanceStudent)) ||
+            !sectionFits(header.preference_offset, header.preference_count, sizeof(uint32_t)) ||
+            header.text_offset > data.size() || header.text_bytes > data.size() - header.text_offset) {
+            cerr << "Error: corrupt instance file: " << filename << endl;
+            return false;
+        }
+
+        const char* base = data.data();
+        string_view text(base + header.text_offset, header.text_bytes);
+        bool valid = true;
+        auto textOf = [&](const InstanceString& ref) {
+            if (ref.offset > text.size() || ref.length > text.size() - ref.offset) {
+                valid = false;
+                return string_view();
+            }
+            return text.substr(ref.offset, ref.length);
+        };
+
+        auto course_records = reinterpret_cast<const InstanceCourse*>(base + header.course_offset);
+        auto slot_records = reinterpret_cast<const InstanceSlot*>(base + header.slot_offset);
+        auto student_records = reinterpret_cast<const InstanceStudent*>(base + header.student_offset);
+        auto preferences = reinterpret_cast<const uint32_t*>(base + header.preference_offset);
+
+        courses.resize(header.course_count);
+        for (size_t i = 0; i < courses.size(); i++) {
+            const InstanceCourse& record = course_records[i];
+            Course& course = courses[i];
+            course.id = textOf(record.id);
+            course.name = textOf(record.name);
+            course.instructor = textOf(record.instructor);
+            course.room = textOf(record.room);
+            course.units = record.units;
+            course.max_students = record.max_students;
+            course.time_mask = record.time_mask;
+            if (record.slot_begin > header.slot_count || record.slot_count > header.slot_count - record.slot_begin) {
+                valid = false;
+                break;
+            }
+            for (uint32_t j = record.slot_begin; j < record.slot_begin + record.slot_count; j++) {
+                TimeSlot slot;
+                slot.day = textOf(slot_records[j].day);
+                slot.start_time = textOf(slot_records[j].start_time);
+                slot.end_time = textOf(slot_records[j].end_time);
+                slot.duration_hours = slot_records[j].duration_hours;
+                slot.day_index = slot_records[j].day_index;
+                slot.start_minute = slot_records[j].start_minute;
+                slot.end_minute = slot_records[j].end_minute;
+                course.time_slots.push_back(slot);
+            }
+        }
+
+        preference_pool.assign(preferences, preferences + header.preference_count);
+        for (uint32_t course : preference_pool) {
+            if (course >= header.course_count) valid = false;
+        }
+
+        students.resize(header.student_count);
+        for (size_t i = 0; i < students.size() && valid; i++) {
+            const InstanceStudent& record = student_records[i];
+            Student& student = students[i];
+            student.id = record.id;
+            student.name = textOf(record.name);
+            student.min_units = record.min_units;
+            student.max_units = record.max_units;
+            student.preference_begin = record.preference_begin;
+            student.preference_count = record.preference_count;
+            student.unavailable_mask = record.unavailable_mask;
+            student.occupied_mask = record.unavailable_mask;
+            if (record.preference_begin > header.preference_count ||
+                record.preference_count > header.preference_count - record.preference_begin) {
+                valid = false;
+            }
+        }
+
+        if (!valid) {
+            cerr << "Error: corrupt instance file: " << filename << endl;
+            students.clear();
+            courses.clear();
+            preference_pool.clear();
+            return false;
+        }
+        input_files.push_back(move(file));
+
+        for (size_t i = 0; i < courses.size(); i++) {
+            uint32_t symbol = course_symbols.intern(courses[i].id);
+            if (symbol >= course_of_symbol.size()) course_of_symbol.resize(symbol + 1, NO_INDEX);
+            course_of_symbol[symbol] = i;
+        }
+        resolved_students = students.size();
+        student_order.resize(students.size());
+        for (size_t i = 0; i < student_order.size(); i++) student_order[i] = i;
+        buildConflictMatrix();
+        buildDepartments();
+
+        *log << "Loaded " << students.size() << " students and " << courses.size()
+             << " courses from compiled instance" << endl;
+        return true;
+    }
+
+    bool hasTimeConflict(const Student& student, const Course& course) const {
+        // occupied_mask holds the student's unavailable times and every
+        // meeting of the courses assigned so far
+        return student.occupied_mask.intersects(course.time_mask);
+    }
+
+    bool meetsUnitConstraints(const Student& student, uint32_t course_index) const {
+        return unitRulesAllow(student, student.total_units, student.three_unit_count,
+                              student.one_unit_count, courses[course_index]);
+    }
+
+    // Unit rules for adding course to a student currently holding the given
+    // totals, which may differ from the student record during a pass
+    static bool unitRulesAllow(const Student& student, int total_units, int three_units,
+                               int one_units, const Course& course) {
+        int new_total = total_units + course.units;
+
+        if (new_total > student.max_units) return false;
+
+        // Check unit type constraints
+        int three_unit_count = three_units + (course.units == 3 ? 1 : 0);
+        int one_unit_count = one_units + (course.units == 3 ? 0 : 1);
+
+        // At most 2 one-unit courses
+        if (one_unit_count > 2) return false;
+
+        // If we're at min units, check if we have at least 3 three-unit courses
+        if (new_total >= student.min_units && three_unit_count < 3) {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool canEnrollInCourse(const Student& student, uint32_t course_index) const {
+        const Course& course = courses[course_index];
+
+        // Check if course is full
+        if ((int)course.enrolled_students.size() >= course.max_students) return false;
+
+        return fitsSchedule(student, course_index);
+    }
+
+    // Every canEnrollInCourse rule except capacity
+    bool fitsSchedule(const Student& student, uint32_t course_index) const {
+        const Course& course = courses[course_index];
+
+        // Check if student already enrolled
+        if (find(student.assigned_courses.begin(), student.assigned_courses.end(), course_index)
+            != student.assigned_courses.end()) return false;
+
+        // Check time conflicts
+        if (hasTimeConflict(student, course)) return false;
+
+        // Check unit constraints
+        if (!meetsUnitConstraints(student, course_index)) return false;
+
+        return true;
+    }
+
+    // A student is scheduled once they reach their minimum units with at
+    // least 3 three-unit courses; the other rules hold for every enrollment
+    static bool meetsSuccessCriteria(const Student& student) {
+        return student.total_units >= student.min_units && student.three_unit_count >= 3;
+    }
+
+    // Assigns the course and updates the student's counters, occupancy and
+    // the course roster. The caller has already checked canEnrollInCourse.
+    void enrollStudent(uint32_t student_index, uint32_t course_index) {
+        recordAssignment(students[student_index], course_index);
+        courses[course_index].enrolled_students.push_back(student_index);
+    }
+
+    // The student's side of enrollStudent, leaving the roster alone
+    void recordAssignment(Student& student, uint32_t course_index) const {
+        const Course& course = courses[course_index];
+        student.assigned_courses.push_back(course_index);
+        student.total_units += course.units;
+        if (course.units == 3) student.three_unit_count++;
+        else student.one_unit_count++;
+        student.occupied_mask |= course.time_mask;
+    }
+
+    // Reverses enrollStudent; returns false if the student did not hold the course
+    bool dropStudent(uint32_t student_index, uint32_t course_index) {
+        Student& student = students[student_index];
+        Course& course = courses[course_index];
+        if (!releaseAssignment(student, course_index)) return false;
+
+        auto roster = find(course.enrolled_students.begin(), course.enrolled_students.end(), student_index);
+        if (roster != course.enrolled_students.end()) course.enrolled_students.erase(roster);
+
+        if (!meetsSuccessCriteria(student)) student.scheduling_successful = false;
+        return true;
+    }
+
+    // The student's side of dropStudent, leaving the roster alone
+    bool releaseAssignment(Student& student, uint32_t course_index) const {
+        const Course& course = courses[course_index];
+        auto assigned = find(student.assigned_courses.begin(), student.assigned_courses.end(), course_index);
+        if (assigned == student.assigned_courses.end()) return false;
+        student.assigned_courses.erase(assigned);
+
+        student.total_units -= course.units;
+        if (course.units == 3) student.three_unit_count--;
+        else student.one_unit_count--;
+
+        // Masks cannot be subtracted; rebuild from the remaining courses
+        student.occupied_mask = student.unavailable_mask;
+        for (uint32_t remaining : student.assigned_courses) {
+            student.occupied_mask |= courses[remaining].time_mask;
+        }
+        return true;
+    }
+
+    IndexRange preferences(const Student& student) const {
+        const uint32_t* first = preference_pool.data() + student.preference_begin;
+        return {first, first + student.preference_count};
+    }
+
+    // Sizes a pass's per-student and per-course arrays against the committed
+    // state; runGreedyPass and component workers call it once per pass
+    void prepareGreedyPass(GreedyPass& pass) const {
+        pass.seats_taken.resize(courses.size());
+        for (size_t c = 0; c < courses.size(); c++) pass.seats_taken[c] = courses[c].enrolled_students.size();
+        pass.added_begin.assign(students.size(), 0);
+        pass.added_count.assign(students.size(), 0);
+        pass.successful.assign(students.size(), 0);
+        pass.class_reference.assign(class_count, NO_INDEX);
+        prepareScratch(pass.scratch);
+        pass.scratch.open.reset(courses.size());
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            if (pass.seats_taken[c] >= courses[c].max_students) pass.scratch.open.close(c);
+        }
+        if (student_ordering == StudentOrder::Scarcity) {
+            pass.demand = preferenceDemand();
+            pass.scratch.ranked = true;
+            rankCatalog(pass);
+        }
+    }
+
+    bool clearOfUnavailable(const Student& student, uint32_t course_index) const {
+        return !student.unavailable_mask.intersects(courses[course_index].time_mask);
+    }
+
+    // Three-unit courses that cover a student's minimum, at least three
+    static int coursesNeeded(const Student& student) {
+        return max(3, (student.min_units + 2) / 3);
+    }
+
+    // Share of each feasible preference a student is expected to ask for:
+    // the courses their minimum needs over the preferences clear of their
+    // unavailable times, at most one
+    float preferenceWeight(const Student& student) const {
+        size_t feasible = 0;
+        for (uint32_t c : preferences(student)) {
+            if (clearOfUnavailable(student, c)) feasible++;
+        }
+        if (feasible == 0) return 0;
+        return min(1.0f, (float)coursesNeeded(student) / feasible);
+    }
+
+    vector<float> preferenceDemand() const {
+        vector<float> demand(courses.size(), 0);
+        for (const auto& student : students) {
+            if (student.scheduling_successful) continue;
+            float weight = preferenceWeight(student);
+            for (uint32_t c : preferences(student)) {
+                if (clearOfUnavailable(student, c)) demand[c] += weight;
+            }
+        }
+        return demand;
+    }
+
+    // Outstanding demand per free seat; full courses rank last
+    static float seatPressure(float demand, int free_seats) {
+        if (free_seats <= 0) return numeric_limits<float>::infinity();
+        return demand / free_seats;
+    }
+
+    float coursePressure(const GreedyPass& pass, uint32_t course_index) const {
+        return seatPressure(pass.demand[course_index],
+                            courses[course_index].max_students - pass.seats_taken[course_index]);
+    }
+
+    // Sorts the catalog into ranking, least pressure first, as the fallback
+    // scope of scratch
+    template <typename Pressure>
+    void rankCatalog(vector<uint32_t>& ranking, TurnScratch& scratch, Pressure pressure) const {
+        ranking.resize(courses.size());
+        for (uint32_t c = 0; c < courses.size(); c++) ranking[c] = c;
+        stable_sort(ranking.begin(), ranking.end(), [&](uint32_t a, uint32_t b) { return pressure(a) < pressure(b); });
+        scratch.ranked_catalog.assign(1, {ranking.data(), ranking.data() + ranking.size()});
+    }
+
+    void rankCatalog(GreedyPass& pass) const {
+        rankCatalog(pass.ranking, pass.scratch, [&](uint32_t c) { return coursePressure(pass, c); });
+        pass.turns_since_ranking = 0;
+    }
+
+    // A student's preferences, least pressure first, for their next turn
+    template <typename Pressure>
+    void rankPreferences(const Student& student, TurnScratch& scratch, Pressure pressure) const {
+        IndexRange preferred = preferences(student);
+        scratch.ranked_preferences.assign(preferred.begin(), preferred.end());
+        stable_sort(scratch.ranked_preferences.begin(), scratch.ranked_preferences.end(),
+                    [&](uint32_t a, uint32_t b) { return pressure(a) < pressure(b); });
+    }
+
+    // Takes a student's weight off their preferences once their turn is over
+    void settleDemand(const Student& student, vector<float>& demand) const {
+        float weight = preferenceWeight(student);
+        for (uint32_t c : preferences(student)) {
+            if (clearOfUnavailable(student, c)) demand[c] -= weight;
+        }
+    }
+
+    // Students needing the fewest seats first, since under a shortage each
+    // extra seat one student holds can cost another their schedule; among
+    // equals, the most constrained first: those whose feasible preferences
+    // promise the fewest seats beyond what they need. The sort is stable, so
+    // ties keep the shuffled order.
+    void orderByScarcity(vector<uint32_t>& order) const {
+        vector<float> demand = preferenceDemand();
+        vector<float> slack(students.size(), 0);
+        for (uint32_t student_index : order) {
+            const Student& student = students[student_index];
+            float supply = 0;
+            for (uint32_t c : preferences(student)) {
+                if (!clearOfUnavailable(student, c)) continue;
+                int free_seats = courses[c].max_students - (int)courses[c].enrolled_students.size();
+                supply += min(1.0f, max(0, free_seats) / max(demand[c], 1.0f));
+            }
+            slack[student_index] = supply - coursesNeeded(student);
+        }
+        stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            int needed_a = coursesNeeded(students[a]), needed_b = coursesNeeded(students[b]);
+            return needed_a != needed_b ? needed_a < needed_b : slack[a] < slack[b];
+        });
+    }
+
+    void prepareScratch(TurnScratch& scratch) const {
+        scratch.blocked.resize(courses.size());
+        scratch.candidates.resize(courses.size());
+    }
+
+    // One student's greedy turn: preferred courses first, then the fallback
+    // scope, until they reach their minimum units with 3 three-unit courses
+    // or run out of room. claimSeat(course) takes a seat if one is free and
+    // reports whether it did; every other enrollment rule is checked here.
+    // Returns whether the student ended up scheduled.
+    template <typename ClaimSeat>
+    bool studentTurn(const Student& student, TurnScratch& scratch, ClaimSeat claimSeat) const {
+        int total_units = student.total_units;
+        int three_units = student.three_unit_count;
+        int one_units = student.one_unit_count;
+        CourseSet& blocked = scratch.blocked;
+        initBlockedCourses(student, blocked);
+
+        // Preferred courses first, then the remaining catalog or departments
+        IndexRange preferred = preferences(student);
+        if (scratch.ranked) {
+            preferred = {scratch.ranked_preferences.data(),
+                         scratch.ranked_preferences.data() + scratch.ranked_preferences.size()};
+        }
+        if (candidate_scope == CandidateScope::Department) {
+            departmentScope(student, scratch.scope);
+            scratch.candidates.start(preferred, &scratch.scope);
+        } else if (scratch.ranked) {
+            scratch.candidates.start(preferred, &scratch.ranked_catalog);
+        } else {
+            scratch.candidates.start(preferred, nullptr, scratch.open.empty() ? nullptr : &scratch.open);
+        }
+
+        // Try to enroll in courses
+        for (uint32_t course_index = scratch.candidates.next(); course_index != NO_INDEX;
+             course_index = scratch.candidates.next()) {
+            const Course& course = courses[course_index];
+
+            // Same checks as canEnrollInCourse, with duplicates and time
+            // conflicts folded into a single bit test
+            if (!blocked.test(course_index) &&
+                unitRulesAllow(student, total_units, three_units, one_units, course) &&
+                claimSeat(course_index)) {
+                total_units += course.units;
+                if (course.units == 3) three_units++;
+                else one_units++;
+                blocked.unionWith(course_conflicts.row(course_index));
+
+                // Check if student has enough units and 3-unit courses
+                if (total_units >= student.min_units && three_units >= 3) return true;
+            }
+
+            // Stop if at maximum units
+            if (total_units >= student.max_units) {
+                break;
+            }
+        }
+        return false;
+    }
+
+    // A student's greedy turn recorded in pass
+    void greedyTurn(GreedyPass& pass, uint32_t student_index) const {
+        const Student& student = students[student_index];
+        pass.added_begin[student_index] = pass.added_courses.size();
+        if (student.scheduling_successful) {
+            pass.successful[student_index] = 1;
+            pass.successful_count++;
+            return;
+        }
+
+        if (pass.scratch.ranked) {
+            rankPreferences(student, pass.scratch, [&](uint32_t c) { return coursePressure(pass, c); });
+        }
+
+        auto claimSeat = [&](uint32_t course_index) {
+            if (pass.seats_taken[course_index] >= courses[course_index].max_students) return false;
+            pass.added_courses.push_back(course_index);
+            pass.added_count[student_index]++;
+            if (++pass.seats_taken[course_index] == courses[course_index].max_students) {
+                pass.scratch.open.close(course_index);
+            }
+            pass.enrollments++;
+            return true;
+        };
+
+        // A turn is decided by which courses claimSeat finds open. Seats only
+        // fill during a pass, so a class member starting from no courses gets
+        // the last full turn of their class again as long as every course
+        // that turn took still has a seat. Scarcity order ranks courses anew
+        // for each turn, so there every turn runs in full.
+        uint32_t* reference = nullptr;
+        if (!pass.scratch.ranked && !student_class.empty() && student.assigned_courses.empty()) {
+            reference = &pass.class_reference[student_class[student_index]];
+        }
+        bool scheduled;
+        if (reference && *reference != NO_INDEX && seatsRemain(pass, *reference)) {
+            uint32_t begin = pass.added_begin[*reference];
+            for (uint32_t i = 0; i < pass.added_count[*reference]; i++) claimSeat(pass.added_courses[begin + i]);
+            scheduled = pass.successful[*reference];
+        } else {
+            scheduled = studentTurn(student, pass.scratch, claimSeat);
+            if (reference) *reference = student_index;
+        }
+        if (scheduled) {
+            pass.successful[student_index] = 1;
+            pass.successful_count++;
+        }
+
+        IndexRange preferred = preferences(student);
+        for (uint32_t i = 0; i < pass.added_count[student_index]; i++) {
+            uint32_t course = pass.added_courses[pass.added_begin[student_index] + i];
+            if (find(preferred.begin(), preferred.end(), course) != preferred.end()) pass.preference_hits++;
+        }
+
+        // The student's demand is settled either way
+        if (pass.scratch.ranked) {
+            settleDemand(student, pass.demand);
+            if (candidate_scope == CandidateScope::Catalog && ++pass.turns_since_ranking >= SCARCITY_RERANK) {
+                rankCatalog(pass);
+            }
+        }
+    }
+
+    // Whether every course a student took during the pass still has a seat
+    bool seatsRemain(const GreedyPass& pass, uint32_t student_index) const {
+        uint32_t begin = pass.added_begin[student_index];
+        for (uint32_t i = 0; i < pass.added_count[student_index]; i++) {
+            uint32_t course_index = pass.added_courses[begin + i];
+            if (pass.seats_taken[course_index] >= courses[course_index].max_students) return false;
+        }
+        return true;
+    }
+
+    // Hashes every student's constraint signature, everything a greedy turn
+    // reads from the student record, into equivalence classes. The courses
+    // ruled out by unavailable times are worked out once per distinct mask.
+    void buildStudentClasses() {
+        unordered_map<string, uint32_t> class_of_signature;
+        class_of_signature.reserve(students.size());
+        student_class.resize(students.size());
+        unordered_map<string, uint32_t> row_of_mask;
+        CourseSet blocked;
+        blocked.resize(courses.size());
+        unavailable_blocked.clear();
+        string signature;
+        for (size_t i = 0; i < students.size(); i++) {
+            Student& student = students[i];
+            signature.assign(reinterpret_cast<const char*>(&student.min_units), sizeof(int));
+            signature.append(reinterpret_cast<const char*>(&student.max_units), sizeof(int));
+            signature.append(reinterpret_cast<const char*>(&student.unavailable_mask), sizeof(WeekMask));
+            signature.append(reinterpret_cast<const char*>(preference_pool.data() + student.preference_begin),
+                             student.preference_count * sizeof(uint32_t));
+            student_class[i] = class_of_signature.emplace(signature, class_of_signature.size()).first->second;
+
+            if (student.unavailable_mask.empty()) continue;
+            signature.resize(2 * sizeof(int) + sizeof(WeekMask));
+            auto row = row_of_mask.emplace(signature.substr(2 * sizeof(int)), row_of_mask.size());
+            if (row.second) {
+                blocked.clear();
+                for (uint32_t c = 0; c < courses.size(); c++) {
+                    if (student.unavailable_mask.intersects(courses[c].time_mask)) blocked.set(c);
+                }
+                unavailable_blocked.insert(unavailable_blocked.end(), blocked.words.begin(), blocked.words.end());
+            }
+            student.unavailable_row = row.first->second;
+        }
+        class_count = class_of_signature.size();
+        *log << "Equivalence classes: " << class_count << " for " << students.size() << " students" << endl;
+    }
+
+    // Runs a greedy pass over pass.order against the committed state. Only
+    // pass is written, so passes can run concurrently.
+    void runGreedyPass(GreedyPass& pass) const {
+        prepareGreedyPass(pass);
+        for (uint32_t student_index : pass.order) greedyTurn(pass, student_index);
+    }
+
+    void commitStudent(const GreedyPass& pass, uint32_t student_index) {
+        uint32_t begin = pass.added_begin[student_index];
+        for (uint32_t i = 0; i < pass.added_count[student_index]; i++) {
+            enrollStudent(student_index, pass.added_courses[begin + i]);
+        }
+        if (pass.successful[student_index]) students[student_index].scheduling_successful = true;
+    }
+
+    // Applies a finished pass to the students and course rosters
+    void commitPass(const GreedyPass& pass) {
+        student_order = pass.order;
+        for (uint32_t student_index : pass.order) commitStudent(pass, student_index);
+    }
+
+    // Under the department scope a student only ever touches the courses of
+    // their preferred departments, so union-find over departments and
+    // preferences splits the instance into components that share no course.
+    // Each component is one pool task walking its students in the global
+    // order, which gives exactly the schedule of a serial pass over order.
+    void scheduleComponents(const vector<uint32_t>& order) {
+        vector<uint32_t> parent(courses.size());
+        for (uint32_t c = 0; c < courses.size(); c++) parent[c] = c;
+        auto root = [&](uint32_t c) {
+            while (parent[c] != c) c = parent[c] = parent[parent[c]];
+            return c;
+        };
+        auto join = [&](uint32_t a, uint32_t b) {
+            a = root(a);
+            b = root(b);
+            if (a != b) parent[max(a, b)] = min(a, b);
+        };
+        for (uint32_t d = 0; d + 1 < department_begin.size(); d++) {
+            for (uint32_t c : departmentCourses(d)) join(department_courses[department_begin[d]], c);
+        }
+        for (const auto& student : students) {
+            IndexRange preferred = preferences(student);
+            for (uint32_t c : preferred) join(*preferred.begin(), c);
+        }
+
+        // Students without preferences have no candidates; scheduled ones
+        // are already done
+        vector<uint32_t> component_of_root(courses.size(), NO_INDEX);
+        vector<uint32_t> component_of_student(students.size(), NO_INDEX);
+        vector<uint32_t> component_begin(1, 0);
+        for (uint32_t student_index : order) {
+            const Student& student = students[student_index];
+            if (student.preference_count == 0 || student.scheduling_successful) continue;
+            uint32_t& component = component_of_root[root(*preferences(student).begin())];
+            if (component == NO_INDEX) {
+                component = component_begin.size() - 1;
+                component_begin.push_back(0);
+            }
+            component_of_student[student_index] = component;
+            component_begin[component + 1]++;
+        }
+        size_t component_count = component_begin.size() - 1;
+        for (size_t k = 0; k < component_count; k++) component_begin[k + 1] += component_begin[k];
+        vector<uint32_t> members(component_begin.back());
+        vector<uint32_t> fill(component_begin.begin(), component_begin.end() - 1);
+        for (uint32_t student_index : order) {
+            uint32_t component = component_of_student[student_index];
+            if (component != NO_INDEX) members[fill[component]++] = student_index;
+        }
+
+        // Largest components first so stealing evens out the tail
+        vector<uint32_t> by_size(component_count);
+        for (uint32_t k = 0; k < component_count; k++) by_size[k] = k;
+        sort(by_size.begin(), by_size.end(), [&](uint32_t a, uint32_t b) {
+            return component_begin[a + 1] - component_begin[a] > component_begin[b + 1] - component_begin[b];
+        });
+
+        ThreadPool& workers = workerPool();
+        vector<GreedyPass> passes(workers.size());
+        for (auto& pass : passes) prepareGreedyPass(pass);
+        vector<uint32_t> component_worker(component_count);
+        for (uint32_t component : by_size) {
+            workers.submit([&, component] {
+                size_t worker = ThreadPool::currentWorker();
+                component_worker[component] = worker;
+                for (uint32_t k = component_begin[component]; k < component_begin[component + 1]; k++) {
+                    greedyTurn(passes[worker], members[k]);
+                }
+            });
+        }
+        workers.wait();
+
+        student_order = order;
+        for (uint32_t student_index : order) {
+            uint32_t component = component_of_student[student_index];
+            if (component != NO_INDEX) commitStudent(passes[component_worker[component]], student_index);
+        }
+        *log << "Scheduled " << component_count << " independent components on " << workers.size()
+             << " threads" << endl;
+    }
+
+    // Greedy turns for batches of students on all worker threads, working on
+    // the committed students directly. Seat counters are atomics claimed by
+    // compare-and-swap, so a course never passes max_students; a claim's
+    // counter value picks the student's slot in a preallocated roster. A
+    // student who loses a seat to a race moves on to their next candidate.
+    // With one thread this is the serial greedy pass over the same order.
+    // Under scarcity order each batch starts from the demand its students
+    // leave outstanding and ranks courses by the seats free at the time, so
+    // with one thread only the catalog re-ranking points differ from serial.
+    void scheduleConcurrent() {
+        vector<uint32_t> order = student_order;
+        shuffle(order.begin(), order.end(), rng);
+        bool scarcity = student_ordering == StudentOrder::Scarcity;
+        vector<vector<float>> batch_demand;
+        if (scarcity) {
+            orderByScarcity(order);
+            vector<float> demand = preferenceDemand();
+            for (size_t first = 0; first < order.size(); first += CONCURRENT_BATCH) {
+                batch_demand.push_back(demand);
+                for (size_t k = first; k < min(order.size(), first + CONCURRENT_BATCH); k++) {
+                    if (!students[order[k]].scheduling_successful) settleDemand(students[order[k]], demand);
+                }
+            }
+        }
+
+        unique_ptr<atomic<int>[]> seats_taken(new atomic<int>[courses.size()]);
+        vector<uint32_t> slot_begin(courses.size() + 1, 0);
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            int enrolled = courses[c].enrolled_students.size();
+            seats_taken[c].store(enrolled, memory_order_relaxed);
+            slot_begin[c + 1] = slot_begin[c] + max(0, courses[c].max_students - enrolled);
+        }
+        vector<uint32_t> roster_slots(slot_begin.back());
+        atomic<size_t> lost_races(0);
+
+        auto claimSeat = [&](uint32_t course_index, uint32_t student_index) {
+            const Course& course = courses[course_index];
+            int taken = seats_taken[course_index].load(memory_order_relaxed);
+            if (taken >= course.max_students) return false;
+            while (!seats_taken[course_index].compare_exchange_weak(taken, taken + 1, memory_order_relaxed)) {
+                if (taken >= course.max_students) {
+                    lost_races.fetch_add(1, memory_order_relaxed);
+                    return false;
+                }
+            }
+            int enrolled = course.enrolled_students.size();
+            roster_slots[slot_begin[course_index] + (taken - enrolled)] = student_index;
+            return true;
+        };
+
+        ThreadPool& workers = workerPool();
+        vector<TurnScratch> scratch(workers.size());
+        for (auto& worker_scratch : scratch) prepareScratch(worker_scratch);
+        size_t batches = 0;
+        for (size_t first = 0; first < order.size(); first += CONCURRENT_BATCH) {
+            size_t last = min(order.size(), first + CONCURRENT_BATCH);
+            size_t batch = batches++;
+            workers.submit([&, first, last, batch] {
+                TurnScratch& own = scratch[ThreadPool::currentWorker()];
+                own.ranked = scarcity;
+
+                // Pressure is read off the shared seat counters once per
+                // ranking, so a sort never sees it change
+                vector<float> demand, pressure;
+                vector<uint32_t> ranking;
+                size_t turns_since_ranking = 0;
+                auto refreshPressure = [&](uint32_t c) {
+                    int taken = seats_taken[c].load(memory_order_relaxed);
+                    pressure[c] = seatPressure(demand[c], courses[c].max_students - taken);
+                };
+                auto byPressure = [&](uint32_t c) { return pressure[c]; };
+                if (scarcity) {
+                    demand = move(batch_demand[batch]);
+                    pressure.resize(courses.size());
+                    for (uint32_t c = 0; c < courses.size(); c++) refreshPressure(c);
+                    rankCatalog(ranking, own, byPressure);
+                }
+
+                for (size_t k = first; k < last; k++) {
+                    uint32_t student_index = order[k];
+                    Student& student = students[student_index];
+                    if (student.scheduling_successful) continue;
+                    if (scarcity) {
+                        for (uint32_t c : preferences(student)) refreshPressure(c);
+                        rankPreferences(student, own, byPressure);
+                    }
+                    bool scheduled = studentTurn(student, own, [&](uint32_t course_index) {
+                        if (!claimSeat(course_index, student_index)) return false;
+                        recordAssignment(student, course_index);
+                        return true;
+                    });
+                    if (scheduled) student.scheduling_successful = true;
+
+                    if (scarcity) {
+                        settleDemand(student, demand);
+                        if (candidate_scope == CandidateScope::Catalog && ++turns_since_ranking >= SCARCITY_RERANK) {
+                            for (uint32_t c = 0; c < courses.size(); c++) refreshPressure(c);
+                            rankCatalog(ranking, own, byPressure);
+                            turns_since_ranking = 0;
+                        }
+                    }
+                }
+            });
+        }
+        workers.wait();
+
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            Course& course = courses[c];
+            int claimed = seats_taken[c].load() - (int)course.enrolled_students.size();
+            course.enrolled_students.insert(course.enrolled_students.end(), roster_slots.begin() + slot_begin[c],
+                                            roster_slots.begin() + slot_begin[c] + claimed);
+        }
+        student_order = order;
+        *log << "Concurrent enrollment: " << batches << " batches on " << workers.size() << " threads, "
+             << lost_races.load() << " seats lost to races" << endl;
+    }
+
+    // Course at a student's draft position: their preferences, then the
+    // catalog in index order without the preferred courses
+    uint32_t draftCandidate(const Student& student, uint32_t position) const {
+        IndexRange preferred = preferences(student);
+        if (position < preferred.size()) return preferred.begin()[position];
+        uint32_t course_index = position - preferred.size();
+        if (find(preferred.begin(), preferred.end(), course_index) != preferred.end()) return NO_INDEX;
+        return course_index;
+    }
+
+    // Advances a student's position to the next course canEnrollInCourse
+    // accepts against the round's starting state, or returns NO_INDEX once
+    // their candidates are exhausted. Each course is judged once, as in a
+    // greedy turn.
+    uint32_t draftProposal(const Student& student, uint32_t& position) const {
+        uint32_t end = student.preference_count + courses.size();
+        for (; position < end; position++) {
+            uint32_t course_index = draftCandidate(student, position);
+            if (course_index != NO_INDEX && canEnrollInCourse(student, course_index)) return course_index;
+        }
+        return NO_INDEX;
+    }
+
+    // Draft: in every round each active student claims at most one course,
+    // so nobody gets a second course before everyone still drafting has had
+    // a chance at a first. Proposals are computed in parallel against the
+    // state at the start of the round; the commit then walks a priority
+    // queue, fewest courses held first, in shuffled order that reverses
+    // every round (a snake draft), and re-checks canEnrollInCourse for each
+    // claim. A student whose course filled up earlier in the round chooses
+    // again on the spot. Rounds repeat until no student can progress.
+    void scheduleDraft() {
+        vector<uint32_t> order = student_order;
+        shuffle(order.begin(), order.end(), rng);
+
+        vector<uint32_t> rank(students.size());
+        for (uint32_t k = 0; k < order.size(); k++) rank[order[k]] = k;
+        vector<uint32_t> position(students.size(), 0);
+        vector<uint32_t> proposal(students.size(), NO_INDEX);
+        vector<uint32_t> active;
+        for (uint32_t student_index : order) {
+            const Student& student = students[student_index];
+            if (!student.scheduling_successful && student.total_units < student.max_units) {
+                active.push_back(student_index);
+            }
+        }
+
+        auto propose = [&](size_t first, size_t last) {
+            for (size_t k = first; k < last; k++) {
+                uint32_t student_index = active[k];
+                proposal[student_index] = draftProposal(students[student_index], position[student_index]);
+            }
+        };
+
+        size_t rounds = 0;
+        while (!active.empty()) {
+            if (thread_count > 1 && active.size() > CONCURRENT_BATCH) {
+                ThreadPool& workers = workerPool();
+                for (size_t first = 0; first < active.size(); first += CONCURRENT_BATCH) {
+                    size_t last = min(active.size(), first + CONCURRENT_BATCH);
+                    workers.submit([&, first, last] { propose(first, last); });
+                }
+                workers.wait();
+            } else {
+                propose(0, active.size());
+            }
+
+            // Smallest key first: fewest courses held, then draft position.
+            // Keys pack both so the heap never touches the students.
+            bool reversed = rounds % 2 == 1;
+            vector<uint64_t> keys;
+            for (uint32_t student_index : active) {
+                if (proposal[student_index] == NO_INDEX) continue;
+                uint32_t pick = reversed ? order.size() - 1 - rank[student_index] : rank[student_index];
+                keys.push_back((uint64_t)students[student_index].assigned_courses.size() << 32 | pick);
+            }
+            priority_queue<uint64_t, vector<uint64_t>, greater<uint64_t>> queue(greater<uint64_t>(), move(keys));
+
+            active.clear();
+            while (!queue.empty()) {
+                uint32_t pick = (uint32_t)queue.top();
+                queue.pop();
+                uint32_t student_index = order[reversed ? order.size() - 1 - pick : pick];
+                Student& student = students[student_index];
+                uint32_t course_index = proposal[student_index];
+
+                // Lost the seat earlier in this round: choose again against
+                // the current state instead of waiting for the next round
+                if (!canEnrollInCourse(student, course_index)) {
+                    course_index = draftProposal(student, position[student_index]);
+                    if (course_index == NO_INDEX) continue;
+                }
+                enrollStudent(student_index, course_index);
+                position[student_index]++;
+                if (meetsSuccessCriteria(student)) {
+                    student.scheduling_successful = true;
+                    continue;
+                }
+                if (student.total_units < student.max_units) active.push_back(student_index);
+            }
+            rounds++;
+        }
+
+        // Seats are spread thin by now. Students short of their minimum hand
+        // theirs back, furthest from it first, and the others keep the
+        // courses they drafted and complete them greedily from their
+        // preferences and the catalog with the seats freed; then a greedy
+        // pass in draft order fills in whoever holds nothing. Releases repeat
+        // until no partial schedule is left, so a student the draft could
+        // not complete ends up with their plain greedy turn: the draft only
+        // decides who keeps their drafted courses and the order of the rest.
+        size_t drafted = 0, released = 0;
+        for (const auto& student : students) drafted += student.scheduling_successful;
+        while (true) {
+            int furthest = 0;
+            for (const auto& student : students) {
+                if (!student.scheduling_successful && !student.assigned_courses.empty()) {
+                    furthest = max(furthest, student.min_units - student.total_units);
+                }
+            }
+            if (furthest == 0) break;
+            for (uint32_t student_index : order) {
+                Student& student = students[student_index];
+                if (student.scheduling_successful || student.assigned_courses.empty() ||
+                    student.min_units - student.total_units < furthest) {
+                    continue;
+                }
+                while (!student.assigned_courses.empty()) dropStudent(student_index, student.assigned_courses.back());
+                released++;
+            }
+            GreedyPass completion;
+            for (uint32_t student_index : order) {
+                if (!students[student_index].assigned_courses.empty()) completion.order.push_back(student_index);
+            }
+            runGreedyPass(completion);
+            commitPass(completion);
+        }
+        size_t completed = 0;
+        for (const auto& student : students) completed += student.scheduling_successful;
+        GreedyPass fill;
+        fill.order = order;
+        runGreedyPass(fill);
+        commitPass(fill);
+
+        *log << "Draft: " << rounds << " rounds, " << drafted << " students complete, " << completed - drafted
+             << " completed after releases, " << released << " partial schedules released" << endl;
+    }
+
+    // SUMMARY block of the results file. Streaming writes it before the
+    // counts are known, so every value can be padded to a fixed width and
+    // the block patched in place at the end.
+    static string resultsHeader(size_t student_count, size_t course_count, size_t successful,
+                                size_t total_enrollments, int width) {
+        auto field = [&](const string& value) {
+            return value + string(max(0, width - (int)value.size()), ' ');
+        };
+        char rate[32];
+        snprintf(rate, sizeof(rate), "%g%%", student_count ? 100.0 * successful / student_count : 0.0);
+
+        string header = "# Course Scheduling Results\n";
+        header += "# Generated schedule for " + field(to_string(student_count) + " students and " +
+                                                      to_string(course_count) + " courses") + "\n\n";
+        header += "SUMMARY\n";
+        header += "Total Students: " + field(to_string(student_count)) + "\n";
+        header += "Successfully Scheduled: " + field(to_string(successful)) + "\n";
+        header += "Success Rate: " + field(rate) + "\n";
+        header += "Total Enrollments: " + field(to_string(total_enrollments)) + "\n\n";
+        return header;
+    }
+
+    // Schedules students as an arrival stream, writing each student's line
+    // as soon as they are placed. Arrivals wait in a lottery window of
+    // window_size students and leave it in random order, so fairness is
+    // close to the full shuffle while memory stays bounded by the window and
+    // the course rosters. Courses must already be loaded. The SUMMARY is
+    // written padded with zero counts; the caller fills it in from totals.
+    template <typename ForEachStudentLine, typename Output>
+    void streamStudents(ForEachStudentLine forEachStudentLine, Output& out, size_t window_size, StreamTotals& totals) {
+        out << resultsHeader(0, courses.size(), 0, 0, STREAM_FIELD_WIDTH);
+        out << "STUDENT SCHEDULES\n";
+        out << "Format: StudentID|Name|TotalUnits|Success|AssignedCourses\n";
+        out << '\n';
+
+        *log << "\nStreaming students with a lottery window of " << window_size << "..." << endl;
+        TurnScratch scratch;
+        prepareScratch(scratch);
+        vector<int> seats_taken(courses.size());
+        vector<vector<int>> roster_ids(courses.size());
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            seats_taken[c] = courses[c].enrolled_students.size();
+            for (uint32_t student_index : courses[c].enrolled_students) {
+                roster_ids[c].push_back(students[student_index].id);
+            }
+        }
+
+        auto place = [&](Student& student) {
+            bool scheduled = studentTurn(student, scratch, [&](uint32_t course_index) {
+                if (seats_taken[course_index] >= courses[course_index].max_students) return false;
+                seats_taken[course_index]++;
+                roster_ids[course_index].push_back(student.id);
+                recordAssignment(student, course_index);
+                return true;
+            });
+            totals.streamed++;
+            totals.successful += scheduled;
+            totals.total_enrollments += student.assigned_courses.size();
+            out << student.id << '|' << student.name << '|' << student.total_units << '|'
+                << (scheduled ? "YES" : "NO") << '|';
+            for (size_t i = 0; i < student.assigned_courses.size(); i++) {
+                if (i > 0) out << ',';
+                out << courses[student.assigned_courses[i]].id;
+            }
+            out << '\n';
+        };
+
+        // Window students keep their preferences at the end of
+        // preference_pool, which is compacted once it is mostly dead entries.
+        // Their names are copied into window_names, one slot per window
+        // position, since a line may not outlive its handler.
+        vector<Student> window;
+        vector<string> window_names(window_size);
+        window.reserve(window_size);
+        vector<LoadDiagnostic> diagnostics;
+        preference_pool.clear();
+        auto compactPreferences = [&] {
+            vector<uint32_t> live;
+            for (auto& student : window) {
+                IndexRange preferred = preferences(student);
+                student.preference_begin = live.size();
+                live.insert(live.end(), preferred.begin(), preferred.end());
+            }
+            preference_pool.swap(live);
+        };
+
+        forEachStudentLine([&](string_view line, int line_number) {
+            Student student;
+            bool parsed = parseStudentLine(line, line_number, student, preference_pool, course_symbols, diagnostics);
+            for (const auto& diagnostic : diagnostics) {
+                cerr << diagnostic.message << " " << diagnostic.line_number << ": " << diagnostic.detail << endl;
+            }
+            diagnostics.clear();
+            if (!parsed) return;
+
+            // Resolve preferences in place, dropping unknown courses
+            uint32_t write = student.preference_begin;
+            for (uint32_t j = student.preference_begin; j < student.preference_begin + student.preference_count; j++) {
+                uint32_t symbol = preference_pool[j];
+                uint32_t course = symbol < course_of_symbol.size() ? course_of_symbol[symbol] : NO_INDEX;
+                if (course != NO_INDEX) preference_pool[write++] = course;
+            }
+            student.preference_count = write - student.preference_begin;
+            preference_pool.resize(write);
+
+            size_t slot = window.size();
+            if (slot < window_size) {
+                window.push_back(student);
+            } else {
+                slot = uniform_int_distribution<size_t>(0, window.size() - 1)(rng);
+                place(window[slot]);
+                window[slot] = student;
+            }
+            window_names[slot].assign(student.name);
+            window[slot].name = window_names[slot];
+            if (preference_pool.size() > window_size * STREAM_POOL_ENTRIES_PER_SLOT + STREAM_POOL_MIN_ENTRIES) {
+                compactPreferences();
+            }
+        });
+
+        shuffle(window.begin(), window.end(), rng);
+        for (auto& student : window) place(student);
+        window.clear();
+        preference_pool.clear();
+
+        out << '\n';
+        out << "COURSE ENROLLMENTS\n";
+        out << "Format: CourseID|Name|Units|EnrolledCount|MaxStudents|EnrolledStudents\n";
+        out << '\n';
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            const Course& course = courses[c];
+            out << course.id << '|' << course.name << '|' << course.units << '|'
+                << roster_ids[c].size() << '|' << course.max_students << '|';
+            for (size_t i = 0; i < roster_ids[c].size(); i++) {
+                if (i > 0) out << ',';
+                out << (long long)roster_ids[c][i];
+            }
+            out << '\n';
+        }
+    }
+
+    void logStreamTotals(const StreamTotals& totals) {
+        *log << "Streaming complete!" << endl;
+        *log << "Successfully scheduled: " << totals.successful << "/" << totals.streamed << " students" << endl;
+        *log << "Total enrollments: " << totals.total_enrollments << endl;
+    }
+
+    // A lottery window needs at least one slot to hold an arrival
+    static bool validWindow(size_t window_size) {
+        if (window_size == 0) {
+            cerr << "Error: the lottery window must hold at least one student" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Streams a students file into a results file, see streamStudents
+    bool scheduleStream(const string& students_file, const string& output_file, size_t window_size) {
+        if (!validWindow(window_size)) return false;
+        MappedFile file;
+        if (!file.open(students_file)) {
+            cerr << "Error opening students file: " << students_file << endl;
+            return false;
+        }
+        ResultWriter out;
+        if (!out.open(output_file)) {
+            cerr << "Error opening output file: " << output_file << endl;
+            return false;
+        }
+
+        StreamTotals totals;
+        streamStudents([&](auto handle) { forEachLine(file.view(), handle); }, out, window_size, totals);
+        if (!out.close() ||
+            !ResultWriter::patch(output_file, 0, resultsHeader(totals.streamed, courses.size(), totals.successful,
+                                                               totals.total_enrollments, STREAM_FIELD_WIDTH))) {
+            cerr << "Error writing output file: " << output_file << endl;
+            return false;
+        }
+
+        logStreamTotals(totals);
+        *log << "Schedule saved to " << output_file << endl;
+        return true;
+    }
+
+    // Streams students lines into results, which must be seekable so the
+    // SUMMARY can be filled in once the stream ends
+    bool scheduleStream(istream& students_in, ostream& results, size_t window_size) {
+        if (!validWindow(window_size)) return false;
+        streampos start = results.tellp();
+        if (start == streampos(-1)) {
+            cerr << "Error: the results stream cannot be rewound to fill in its SUMMARY" << endl;
+            return false;
+        }
+
+        StreamTotals totals;
+        streamStudents([&](auto handle) { forEachLine(students_in, handle); }, results, window_size, totals);
+        streampos end = results.tellp();
+        results.seekp(start);
+        results << resultsHeader(totals.streamed, courses.size(), totals.successful, totals.total_enrollments,
+                                 STREAM_FIELD_WIDTH);
+        results.seekp(end);
+        if (!results) {
+            cerr << "Error writing the results stream" << endl;
+            return false;
+        }
+
+        logStreamTotals(totals);
+        return true;
+    }
+
+    void setCandidateScope(CandidateScope scope) {
+        candidate_scope = scope;
+    }
+
+    void setStudentOrder(StudentOrder order) {
+        student_ordering = order;
+    }
+
+    // Enrollment changes made by the improvement phase go through the move
+    // log so an unsuccessful attempt can be undone
+    void loggedEnroll(uint32_t student_index, uint32_t course_index) {
+        enrollStudent(student_index, course_index);
+        move_log.push_back({student_index, course_index, true});
+    }
+
+    void loggedDrop(uint32_t student_index, uint32_t course_index) {
+        dropStudent(student_index, course_index);
+        move_log.push_back({student_index, course_index, false});
+    }
+
+    // Undoes every move after mark, newest first. The oldest undo of each
+    // student restores their original courses and so their original flag.
+    void rollbackMoves(size_t mark) {
+        while (move_log.size() > mark) {
+            MoveRecord move = move_log.back();
+            move_log.pop_back();
+            if (move.enrolled) dropStudent(move.student, move.course);
+            else enrollStudent(move.student, move.course);
+            students[move.student].scheduling_successful = meetsSuccessCriteria(students[move.student]);
+        }
+    }
+
+    // Students touched after mark are successful exactly when they meet the
+    // criteria again; the greedy pass leaves no other kind of student
+    void refreshSuccessFlags(size_t mark) {
+        for (size_t i = mark; i < move_log.size(); i++) {
+            Student& student = students[move_log[i].student];
+            student.scheduling_successful = meetsSuccessCriteria(student);
+        }
+    }
+
+    // Moves a holder out of course_index into another course with a free
+    // seat, starting at a random point in the catalog, so that a scheduled
+    // holder stays scheduled and any other holder keeps at least their
+    // units. Seats released by the student being placed make this a swap.
+    // Returns false with nothing changed.
+    bool relocateHolder(uint32_t holder, uint32_t course_index) {
+        Student& student = students[holder];
+        bool was_scheduled = student.scheduling_successful;
+        int units_before = student.total_units;
+        size_t mark = move_log.size();
+        loggedDrop(holder, course_index);
+        uint32_t offset = uniform_int_distribution<uint32_t>(0, courses.size() - 1)(rng);
+        for (uint32_t i = 0; i < courses.size(); i++) {
+            uint32_t alternative = (offset + i) % courses.size();
+            if (alternative == course_index || !canEnrollInCourse(student, alternative)) continue;
+            loggedEnroll(holder, alternative);
+            if (was_scheduled ? meetsSuccessCriteria(student) : student.total_units >= units_before) {
+                refreshSuccessFlags(mark);
+                return true;
+            }
+            move_log.pop_back();
+            dropStudent(holder, alternative);
+        }
+        rollbackMoves(mark);
+        return false;
+    }
+
+    // Makes room in a full course without lowering the number of scheduled
+    // students. A holder who is not scheduled moves elsewhere if that keeps
+    // their units, and otherwise gives up the seat outright; improveStudent
+    // counts the units lost that way. A scheduled holder relocates to
+    // another course that keeps them scheduled, which may in turn free a
+    // seat deeper in the chain. Students in chain are mid-move and never
+    // ejected. Returns false with nothing changed.
+    bool freeSeat(uint32_t course_index, int depth, vector<uint32_t>& chain,
+                  chrono::steady_clock::time_point deadline) {
+        vector<uint32_t> holders;
+        for (uint32_t holder : courses[course_index].enrolled_students) {
+            if (find(chain.begin(), chain.end(), holder) == chain.end()) holders.push_back(holder);
+        }
+        shuffle(holders.begin(), holders.end(), rng);
+        if (holders.size() > EJECTION_SAMPLE) holders.resize(EJECTION_SAMPLE);
+
+        for (uint32_t holder : holders) {
+            if (!students[holder].scheduling_successful && relocateHolder(holder, course_index)) return true;
+        }
+        for (uint32_t holder : holders) {
+            if (!students[holder].scheduling_successful) {
+                loggedDrop(holder, course_index);
+                return true;
+            }
+        }
+
+        for (uint32_t holder : holders) {
+            if (chrono::steady_clock::now() >= deadline) return false;
+            if (relocateHolder(holder, course_index)) return true;
+
+            // A preferred course that is full, if its own holders can move on
+            size_t mark = move_log.size();
+            loggedDrop(holder, course_index);
+            chain.push_back(holder);
+            Student& student = students[holder];
+            if (depth > 1) {
+                for (uint32_t alternative : preferences(student)) {
+                    if (alternative == course_index || !fitsSchedule(student, alternative)) continue;
+                    size_t chain_mark = move_log.size();
+                    if (!freeSeat(alternative, depth - 1, chain, deadline)) continue;
+                    loggedEnroll(holder, alternative);
+                    // Someone deeper in the chain may have moved into the seat
+                    // this chain set out to free
+                    const Course& course = courses[course_index];
+                    if (meetsSuccessCriteria(student) && (int)course.enrolled_students.size() < course.max_students) {
+                        chain.pop_back();
+                        refreshSuccessFlags(mark);
+                        return true;
+                    }
+                    rollbackMoves(chain_mark);
+                }
+            }
+
+            chain.pop_back();
+            rollbackMoves(mark);
+        }
+        return false;
+    }
+
+    // Units the moves after mark took from students who are still not
+    // scheduled, the price a change pays for the student it schedules
+    int unitsTakenFromUnscheduled(size_t mark) const {
+        vector<pair<uint32_t, int>> change;
+        for (size_t i = mark; i < move_log.size(); i++) {
+            const MoveRecord& move = move_log[i];
+            int units = move.enrolled ? courses[move.course].units : -courses[move.course].units;
+            auto it = find_if(change.begin(), change.end(), [&](const pair<uint32_t, int>& entry) {
+                return entry.first == move.student;
+            });
+            if (it == change.end()) change.push_back({move.student, units});
+            else it->second += units;
+        }
+        int taken = 0;
+        for (const auto& [student_index, units] : change) {
+            if (units < 0 && !students[student_index].scheduling_successful) taken -= units;
+        }
+        return taken;
+    }
+
+    // Tries to schedule one unscheduled student: their partial courses are
+    // released, then courses are taken in preference order followed by the
+    // catalog from a random point, ejecting or relocating holders of full
+    // courses. Everything is rolled back unless the student ends up
+    // scheduled; units_taken adds what the change cost unscheduled holders.
+    bool improveStudent(uint32_t student_index, chrono::steady_clock::time_point deadline, size_t& units_taken) {
+        Student& student = students[student_index];
+        size_t mark = move_log.size();
+        while (!student.assigned_courses.empty()) loggedDrop(student_index, student.assigned_courses.back());
+
+        vector<uint32_t> candidates(preferences(student).begin(), preferences(student).end());
+        uint32_t offset = uniform_int_distribution<uint32_t>(0, courses.size() - 1)(rng);
+        for (uint32_t i = 0; i < courses.size(); i++) candidates.push_back((offset + i) % courses.size());
+
+        vector<uint32_t> chain = {student_index};
+        for (uint32_t course_index : candidates) {
+            if (chrono::steady_clock::now() >= deadline) break;
+            if (!fitsSchedule(student, course_index)) continue;
+            if ((int)courses[course_index].enrolled_students.size() >= courses[course_index].max_students &&
+                !freeSeat(course_index, EJECTION_DEPTH, chain, deadline)) {
+                continue;
+            }
+            loggedEnroll(student_index, course_index);
+            if (meetsSuccessCriteria(student) || student.total_units >= student.max_units) break;
+        }
+
+        bool improved = meetsSuccessCriteria(student);
+        if (improved) {
+            refreshSuccessFlags(mark);
+            units_taken += unitsTakenFromUnscheduled(mark);
+        } else {
+            rollbackMoves(mark);
+        }
+        move_log.resize(mark);
+        return improved;
+    }
+
+    // Anytime local search over the committed schedule. Every accepted
+    // change schedules one more student and keeps everyone else scheduled,
+    // so the schedule in place when the budget runs out is the best found.
+    // Partial schedules of unscheduled students may shrink on the way; the
+    // units they lose are counted and logged.
+    void improveSchedule(double budget_ms) {
+        auto started = chrono::steady_clock::now();
+        auto deadline = started + chrono::duration_cast<chrono::steady_clock::duration>(
+                                      chrono::duration<double, milli>(budget_ms));
+
+        vector<uint32_t> unscheduled;
+        for (uint32_t i = 0; i < students.size(); i++) {
+            if (!students[i].scheduling_successful) unscheduled.push_back(i);
+        }
+
+        size_t attempts = 0, improved = 0, units_taken = 0;
+        while (!unscheduled.empty() && !courses.empty() && chrono::steady_clock::now() < deadline) {
+            size_t pick = uniform_int_distribution<size_t>(0, unscheduled.size() - 1)(rng);
+            attempts++;
+            if (improveStudent(unscheduled[pick], deadline, units_taken)) {
+                improved++;
+                unscheduled[pick] = unscheduled.back();
+                unscheduled.pop_back();
+            }
+        }
+
+        double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        *log << "Improvement phase: " << improved << " more students scheduled in " << attempts
+             << " attempts (" << elapsed << " ms), " << units_taken << " units taken from unscheduled students"
+             << endl;
+    }
+
+    // Number of greedy passes per scheduleStudents call, each with its own
+    // shuffle; 0 runs one per worker thread
+    void setStartCount(size_t count) {
+        start_count = count;
+    }
+
+    // Time the improvement phase may spend after the greedy pass; 0 skips it
+    void setImproveBudget(double milliseconds) {
+        improve_budget_ms = milliseconds;
+    }
+
+    // Three-unit courses a student must hold to be scheduled, or 0 when the
+    // unit rules rule it out next to the one-unit courses they already hold.
+    // A second three-unit course may not reach the minimum before the third
+    // is held, and at most 2 one-unit courses can top up the rest.
+    static int threeUnitDemand(const Student& student) {
+        if (student.min_units <= 6) return 0;
+        int rest = student.min_units - 2;           // after 2 one-unit courses
+        int needed = max(3, (rest + 2) / 3);        // rest / 3 rounded up
+        return 3 * needed + student.one_unit_count <= student.max_units ? needed : 0;
+    }
+
+    // Seat allocation as min-cost flow: source -> student (capacity = the
+    // three-unit courses they still need) -> course (one seat, cost by
+    // preference) -> sink (free seats). Flow ignores time conflicts, so each
+    // student keeps a conflict-free subset of their allocation, cheapest
+    // first, and the next round re-flows the rest without the clashing arcs.
+    // Students are then topped up with one-unit courses; whoever is still
+    // short hands back their seats before a greedy pass fills the gaps.
+    void allocateByFlow() {
+        vector<uint32_t> three_unit_courses;
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            if (courses[c].units == 3) three_unit_courses.push_back(c);
+        }
+
+        vector<int> remaining(students.size(), 0);
+        for (uint32_t i = 0; i < students.size(); i++) {
+            const Student& student = students[i];
+            int demand = threeUnitDemand(student);
+            if (!student.scheduling_successful && demand > student.three_unit_count) {
+                remaining[i] = demand - student.three_unit_count;
+            }
+        }
+
+        const uint32_t source = 0, sink = 1;
+        auto studentNode = [](uint32_t i) { return 2 + i; };
+        auto courseNode = [&](uint32_t c) { return 2 + (uint32_t)students.size() + c; };
+
+        CourseSet blocked;
+        blocked.resize(courses.size());
+        vector<uint32_t> arc_ids, arc_student, arc_course;
+        size_t seats_kept = 0, seats_repaired = 0, withdrawn = 0;
+        int rounds = 0;
+
+        for (; rounds < FLOW_ROUNDS; rounds++) {
+            seat_flow.reset(2 + students.size() + courses.size());
+            arc_ids.clear();
+            arc_student.clear();
+            arc_course.clear();
+
+            for (uint32_t i = 0; i < students.size(); i++) {
+                if (remaining[i] == 0) continue;
+                const Student& student = students[i];
+                initBlockedCourses(student, blocked);
+                size_t first_arc = arc_ids.size();
+                auto addChoice = [&](uint32_t c, int cost) {
+                    arc_ids.push_back(seat_flow.addArc(studentNode(i), courseNode(c), 1, cost));
+                    arc_student.push_back(i);
+                    arc_course.push_back(c);
+                    blocked.set(c);
+                };
+
+                int rank = 0;
+                for (uint32_t c : preferences(student)) {
+                    if (courses[c].units == 3 && !blocked.test(c)) addChoice(c, rank);
+                    rank++;
+                }
+                size_t fallback = 0;
+                if (!three_unit_courses.empty()) {
+                    size_t offset = uniform_int_distribution<size_t>(0, three_unit_courses.size() - 1)(rng);
+                    for (size_t k = 0; k < three_unit_courses.size() && fallback < FLOW_FALLBACK_ARCS; k++) {
+                        uint32_t c = three_unit_courses[(offset + k) % three_unit_courses.size()];
+                        if (blocked.test(c)) continue;
+                        addChoice(c, FLOW_MISS_COST);
+                        fallback++;
+                    }
+                }
+                if (arc_ids.size() > first_arc) seat_flow.addArc(source, studentNode(i), remaining[i], 0);
+            }
+            for (uint32_t c = 0; c < courses.size(); c++) {
+                int free_seats = courses[c].max_students - (int)courses[c].enrolled_students.size();
+                if (free_seats > 0) seat_flow.addArc(courseNode(c), sink, free_seats, 0);
+            }
+
+            if (seat_flow.solve(source, sink) == 0) break;
+
+            // Arcs are grouped by student, cheapest first
+            size_t repaired = 0;
+            for (size_t k = 0; k < arc_ids.size(); k++) {
+                if (seat_flow.flowOn(arc_ids[k]) == 0) continue;
+                uint32_t i = arc_student[k];
+                if (remaining[i] > 0 && canEnrollInCourse(students[i], arc_course[k])) {
+                    enrollStudent(i, arc_course[k]);
+                    remaining[i]--;
+                    seats_kept++;
+                } else {
+                    repaired++;
+                }
+            }
+            seats_repaired += repaired;
+            if (repaired > 0) continue;
+
+            // No conflicts left to repair. Flow maximises seats rather than
+            // complete schedules, so the students furthest from their demand
+            // give their seats back for the others to complete in the next round.
+            int worst = 0;
+            for (uint32_t i = 0; i < students.size(); i++) {
+                if (!students[i].assigned_courses.empty()) worst = max(worst, remaining[i]);
+            }
+            if (worst == 0) {
+                rounds++;
+                break;
+            }
+            for (uint32_t i = 0; i < students.size(); i++) {
+                if (remaining[i] < worst || students[i].assigned_courses.empty()) continue;
+                Student& student = students[i];
+                while (!student.assigned_courses.empty()) dropStudent(i, student.assigned_courses.back());
+                remaining[i] = 0;
+                withdrawn++;
+            }
+        }
+
+        // One-unit top-up, then release students who still fall short
+        size_t released = 0;
+        for (uint32_t i = 0; i < students.size(); i++) {
+            Student& student = students[i];
+            if (student.scheduling_successful) continue;
+            int demand = threeUnitDemand(student);
+            if (demand > 0 && student.three_unit_count >= demand) {
+                CandidateOrder candidates(courses.size());
+                candidates.start(preferences(student));
+                for (uint32_t c = candidates.next(); c != NO_INDEX && !meetsSuccessCriteria(student);
+                     c = candidates.next()) {
+                    if (courses[c].units != 3 && canEnrollInCourse(student, c)) enrollStudent(i, c);
+                }
+            }
+            if (meetsSuccessCriteria(student)) {
+                student.scheduling_successful = true;
+            } else if (!student.assigned_courses.empty()) {
+                while (!student.assigned_courses.empty()) dropStudent(i, student.assigned_courses.back());
+                released++;
+            }
+        }
+
+        *log << "Flow allocation: " << seats_kept << " seats in " << rounds << " rounds ("
+             << seats_repaired << " conflicting seats re-flowed, " << withdrawn + released
+             << " partial schedules released)" << endl;
+
+        GreedyPass fill;
+        fill.order = student_order;
+        shuffle(fill.order.begin(), fill.order.end(), rng);
+        runGreedyPass(fill);
+        commitPass(fill);
+    }
+
+    bool exactLimitReached(ExactSearch& search) {
+        search.nodes++;
+        if (search.node_limit > 0 && search.nodes > search.node_limit) search.stopped = true;
+        if (search.has_deadline && search.nodes % 256 == 0 && chrono::steady_clock::now() >= search.deadline) {
+            search.stopped = true;
+        }
+        return search.stopped;
+    }
+
+    // Scheduled students so far plus those from position on that could still
+    // be scheduled: each needs enough three-unit options with a free seat,
+    // and together they cannot take more than the free three-unit seats,
+    // which serve the smallest remaining demands first
+    size_t exactBound(const ExactSearch& search, size_t position) {
+        size_t by_seats = search.successes;
+        long long seats = search.free_three_seats;
+        const uint32_t* counts = &search.demand_counts[position * (search.max_demand + 1)];
+        for (int demand = 1; demand <= search.max_demand && seats >= demand; demand++) {
+            long long taken = min<long long>(counts[demand], seats / demand);
+            by_seats += taken;
+            seats -= taken * demand;
+        }
+        size_t bound = search.successes + (search.order.size() - position);
+        if (min(bound, by_seats) <= search.best) return min(bound, by_seats);
+
+        size_t possible = 0;
+        for (size_t k = position; k < search.order.size(); k++) {
+            uint32_t student = search.order[k];
+            int available = 0;
+            for (uint32_t c : search.options[student]) {
+                if (courses[c].units != 3) break;
+                if (search.free_seats[c] > 0 && ++available >= search.demand[student]) break;
+            }
+            if (available >= search.demand[student]) possible++;
+        }
+        return min(search.successes + possible, by_seats);
+    }
+
+    void exactPlace(ExactSearch& search, uint32_t student, uint32_t course) {
+        const Course& placed = courses[course];
+        search.assignment.push_back({student, course});
+        search.previous_occupied.push_back(search.occupied[student]);
+        search.occupied[student] |= placed.time_mask;
+        search.total_units[student] += placed.units;
+        if (placed.units == 3) {
+            search.three_units[student]++;
+            search.free_three_seats--;
+        } else {
+            search.one_units[student]++;
+        }
+        search.free_seats[course]--;
+    }
+
+    void exactUndo(ExactSearch& search) {
+        auto [student, course] = search.assignment.back();
+        const Course& placed = courses[course];
+        search.occupied[student] = search.previous_occupied.back();
+        search.assignment.pop_back();
+        search.previous_occupied.pop_back();
+        search.total_units[student] -= placed.units;
+        if (placed.units == 3) {
+            search.three_units[student]--;
+            search.free_three_seats++;
+        } else {
+            search.one_units[student]--;
+        }
+        search.free_seats[course]++;
+    }
+
+    // Enumerates the minimal schedules of the student at position, taking
+    // options in increasing order so each course set is built once. Three-
+    // unit options come first, the only order the unit rules never reject.
+    void exactScheduleStudent(ExactSearch& search, size_t position, size_t next_option) {
+        uint32_t student_index = search.order[position];
+        const Student& student = students[student_index];
+        if (search.total_units[student_index] >= student.min_units && search.three_units[student_index] >= 3) {
+            search.successes++;
+            exactSearchFrom(search, position + 1);
+            search.successes--;
+            return;
+        }
+
+        const vector<uint32_t>& options = search.options[student_index];
+        for (size_t k = next_option; k < options.size() && !search.stopped; k++) {
+            uint32_t c = options[k];
+            if (search.free_seats[c] == 0 || search.occupied[student_index].intersects(courses[c].time_mask) ||
+                !unitRulesAllow(student, search.total_units[student_index], search.three_units[student_index],
+                                search.one_units[student_index], courses[c])) {
+                continue;
+            }
+            exactPlace(search, student_index, c);
+            exactScheduleStudent(search, position, k + 1);
+            exactUndo(search);
+        }
+    }
+
+    // Decides the student at position: scheduled in each possible way, then
+    // left unscheduled with no seats
+    void exactSearchFrom(ExactSearch& search, size_t position) {
+        if (exactLimitReached(search)) return;
+        if (position == search.order.size()) {
+            if (search.successes > search.best) {
+                search.best = search.successes;
+                search.best_assignment = search.assignment;
+            }
+            return;
+        }
+
+        size_t bound = exactBound(search, position);
+        if (bound <= search.best) return;
+        exactScheduleStudent(search, position, 0);
+        if (!search.stopped) exactSearchFrom(search, position + 1);
+        if (search.stopped) search.open_bound = max(search.open_bound, bound);
+    }
+
+    // Branch-and-bound for the largest number of scheduled students, seeded
+    // with a greedy pass as the incumbent. Stops at the node or time limit
+    // with the best schedule found and its gap to the upper bound. Students
+    // left unscheduled are filled greedily afterwards.
+    void scheduleExact() {
+        ExactSearch search;
+        search.node_limit = exact_node_limit;
+        if (exact_time_limit_ms > 0) {
+            search.has_deadline = true;
+            search.deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(
+                                                                chrono::duration<double, milli>(exact_time_limit_ms));
+        }
+
+        size_t already_scheduled = 0;
+        search.options.resize(students.size());
+        search.demand.assign(students.size(), 0);
+        for (uint32_t i = 0; i < students.size(); i++) {
+            const Student& student = students[i];
+            search.occupied.push_back(student.occupied_mask);
+            search.total_units.push_back(student.total_units);
+            search.three_units.push_back(student.three_unit_count);
+            search.one_units.push_back(student.one_unit_count);
+            if (student.scheduling_successful) {
+                already_scheduled++;
+                continue;
+            }
+            int demand = threeUnitDemand(student);
+            if (demand == 0 || demand <= student.three_unit_count) continue;
+            search.demand[i] = demand - student.three_unit_count;
+
+            // Preferred courses first within each unit group
+            vector<uint32_t>& options = search.options[i];
+            for (bool three_unit : {true, false}) {
+                size_t group_start = options.size();
+                for (uint32_t c : preferences(student)) {
+                    if ((courses[c].units == 3) == three_unit && !student.occupied_mask.intersects(courses[c].time_mask)) {
+                        options.push_back(c);
+                    }
+                }
+                size_t preferred_end = options.size();
+                for (uint32_t c = 0; c < courses.size(); c++) {
+                    if ((courses[c].units == 3) == three_unit && !student.occupied_mask.intersects(courses[c].time_mask) &&
+                        find(options.begin() + group_start, options.begin() + preferred_end, c) ==
+                            options.begin() + preferred_end) {
+                        options.push_back(c);
+                    }
+                }
+            }
+            search.order.push_back(i);
+        }
+
+        // Most constrained first: the fewest spare three-unit options
+        auto slack = [&](uint32_t i) {
+            int count = 0;
+            for (uint32_t c : search.options[i]) count += courses[c].units == 3;
+            return count - search.demand[i];
+        };
+        stable_sort(search.order.begin(), search.order.end(),
+                    [&](uint32_t a, uint32_t b) { return slack(a) < slack(b); });
+
+        for (uint32_t i : search.order) search.max_demand = max(search.max_demand, search.demand[i]);
+        size_t width = search.max_demand + 1;
+        search.demand_counts.assign((search.order.size() + 1) * width, 0);
+        for (size_t k = search.order.size(); k-- > 0;) {
+            copy_n(&search.demand_counts[(k + 1) * width], width, &search.demand_counts[k * width]);
+            search.demand_counts[k * width + search.demand[search.order[k]]]++;
+        }
+
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            search.free_seats.push_back(max(0, courses[c].max_students - (int)courses[c].enrolled_students.size()));
+            if (courses[c].units == 3) search.free_three_seats += search.free_seats[c];
+        }
+
+        // Incumbent: the schedules of the students a greedy pass completes
+        GreedyPass incumbent;
+        incumbent.order = student_order;
+        shuffle(incumbent.order.begin(), incumbent.order.end(), rng);
+        runGreedyPass(incumbent);
+        for (uint32_t i = 0; i < students.size(); i++) {
+            if (!incumbent.successful[i] || students[i].scheduling_successful) continue;
+            search.best++;
+            for (uint32_t k = 0; k < incumbent.added_count[i]; k++) {
+                search.best_assignment.push_back({i, incumbent.added_courses[incumbent.added_begin[i] + k]});
+            }
+        }
+        size_t greedy_best = search.best;
+
+        exactSearchFrom(search, 0);
+
+        for (auto [student, course] : search.best_assignment) enrollStudent(student, course);
+        for (auto& student : students) {
+            if (meetsSuccessCriteria(student)) student.scheduling_successful = true;
+        }
+
+        size_t best = already_scheduled + search.best;
+        *log << "Exact search: " << search.nodes << " nodes, greedy incumbent " << already_scheduled + greedy_best;
+        if (search.stopped) {
+            size_t upper = already_scheduled + max(search.best, search.open_bound);
+            *log << ", stopped at limit with " << best << " scheduled, upper bound " << upper
+                 << " (gap " << (upper > 0 ? 100.0 * (upper - best) / upper : 0.0) << "%)" << endl;
+        } else {
+            *log << ", optimal " << best << " scheduled" << endl;
+        }
+
+        GreedyPass fill;
+        fill.order = incumbent.order;
+        runGreedyPass(fill);
+        commitPass(fill);
+    }
+
+    // Limits for the exact engine; 0 leaves a limit off
+    void setExactLimits(size_t node_limit, double time_limit_ms) {
+        exact_node_limit = node_limit;
+        exact_time_limit_ms = time_limit_ms;
+    }
 
-            string time_part = slot_str.substr(0, colon_pos);
-            string duration_str = slot_str.substr(colon_pos + 1);
+    // Runs start_count shuffled greedy passes and commits the best
+    void scheduleGreedy() {
+        size_t passes = start_count == 0 ? thread_count : start_count;
+        vector<GreedyPass> results(max<size_t>(passes, 1));
 
-            if (!duration_str.empty()) {
-                slot.duration_hours = stoi(duration_str);
+        // Shuffle students for fair distribution. The first pass continues
+        // the scheduler's own generator; the others derive their seeds from it.
+        for (size_t i = 0; i < results.size(); i++) {
+            results[i].order = student_order;
+            results[i].seed = seed + i * 0x9E3779B9u;
+            if (i == 0) {
+                shuffle(results[i].order.begin(), results[i].order.end(), rng);
             } else {
-                slot.duration_hours = 1;
-            }
-
-            size_t underscore_pos = time_part.find('_');
-            if (underscore_pos == string::npos) {
-                cerr << "Warning: Invalid time slot format (no underscore): " << slot_str << endl;
-                slot.day = "Monday";
-                slot.start_time = "08:00";
-                slot.end_time = "09:00";
-                return slot;
+                mt19937 pass_rng(results[i].seed);
+                shuffle(results[i].order.begin(), results[i].order.end(), pass_rng);
             }
+            if (student_ordering == StudentOrder::Scarcity) orderByScarcity(results[i].order);
+        }
 
-            slot.day = time_part.substr(0, underscore_pos);
+        if (results.size() == 1 && candidate_scope == CandidateScope::Department && thread_count > 1) {
+            scheduleComponents(results[0].order);
+            return;
+        }
 
-            string time_range = time_part.substr(underscore_pos + 1);
-            size_t dash_pos = time_range.find('-');
-            if (dash_pos == string::npos) {
-                cerr << "Warning: Invalid time range format (no dash): " << slot_str << endl;
-                slot.start_time = "08:00";
-                slot.end_time = "09:00";
-                return slot;
+        if (results.size() == 1) {
+            runGreedyPass(results[0]);
+        } else {
+            ThreadPool& workers = workerPool();
+            for (auto& pass : results) {
+                workers.submit([this, &pass] { runGreedyPass(pass); });
             }
+            workers.wait();
+        }
 
-            slot.start_time = time_range.substr(0, dash_pos);
-            slot.end_time = time_range.substr(dash_pos + 1);
+        // Keep the best pass; ties go to the earliest so runs are reproducible
+        size_t best = 0;
+        for (size_t i = 1; i < results.size(); i++) {
+            if (results[i].betterThan(results[best])) best = i;
+        }
+        commitPass(results[best]);
 
-        } catch (const exception& e) {
-            cerr << "Error parsing time slot '" << slot_str << "': " << e.what() << endl;
-            // Provide safe defaults
-            slot.day = "Monday";
-            slot.start_time = "08:00";
-            slot.end_time = "09:00";
-            slot.duration_hours = 1;
+        if (results.size() > 1) {
+            *log << "Best of " << results.size() << " passes: pass " << best + 1
+                 << " (" << results[best].preference_hits << " preferred courses granted)" << endl;
         }
+    }
 
-        return slot;
+    void setEngine(Engine selected) {
+        engine = selected;
     }
 
-public:
-    Scheduler() : rng(random_device{}()) {}
+    void scheduleStudents() {
+        *log << "\nStarting scheduling process..." << endl;
+        if (student_class.size() != students.size()) buildStudentClasses();
 
-    bool loadStudents(const string& filename) {
-        ifstream file(filename);
-        if (!file.is_open()) {
-            cerr << "Error opening students file: " << filename << endl;
-            return false;
+        switch (engine) {
+        case Engine::Flow:
+            allocateByFlow();
+            break;
+        case Engine::Exact:
+            scheduleExact();
+            break;
+        case Engine::Concurrent:
+            scheduleConcurrent();
+            break;
+        case Engine::Draft:
+            scheduleDraft();
+            break;
+        case Engine::Greedy:
+            scheduleGreedy();
+            break;
         }
+        *log << "Scheduling complete!" << endl;
 
-        string line;
-        int line_number = 0;
-        while (getline(file, line)) {
-            line_number++;
-            // Skip comments and empty lines
-            if (line.empty() || line[0] == '#') continue;
+        if (improve_budget_ms > 0) improveSchedule(improve_budget_ms);
 
-            vector<string> parts = split(line, '|');
-            if (parts.size() != 6) {
-                cerr << "Warning: Skipping malformed line " << line_number << ": " << line << endl;
-                continue;
-            }
+        size_t scheduled_students = 0, total_enrollments = 0;
+        for (const auto& student : students) {
+            if (student.scheduling_successful) scheduled_students++;
+            total_enrollments += student.assigned_courses.size();
+        }
+        *log << "Successfully scheduled: " << scheduled_students << "/" << students.size() << " students" << endl;
+        *log << "Total enrollments: " << total_enrollments << endl;
+    }
 
-            try {
-                Student student;
-                student.id = stoi(parts[0]);
-                student.name = parts[1];
-                student.min_units = stoi(parts[2]);
-                student.max_units = stoi(parts[3]);
+    // Rebuilds seats and occupancy from a results file written by an earlier
+    // run: every student line is replayed through canEnrollInCourse in file
+    // order, which also becomes the output order. Students missing from the
+    // file follow with no courses.
+    bool loadPreviousResults(const string& filename) {
+        MappedFile file;
+        if (!file.open(filename)) {
+            cerr << "Error opening previous results: " << filename << endl;
+            return false;
+        }
 
-                // Parse preferred courses
-                if (!parts[4].empty()) {
-                    student.preferred_courses = split(parts[4], ',');
-                }
+        unordered_map<int, uint32_t> index_of_id;
+        for (uint32_t i = 0; i < students.size(); i++) index_of_id[students[i].id] = i;
 
-                // Parse unavailable times
-                if (!parts[5].empty()) {
-                    student.unavailable_times = split(parts[5], ',');
-                }
+        vector<uint8_t> listed(students.size(), 0);
+        vector<uint32_t> order;
+        bool in_schedules = false;
+        size_t rejected = 0;
+        forEachLine(file.view(), [&](string_view line, int line_number) {
+            if (line == "STUDENT SCHEDULES") {
+                in_schedules = true;
+                return;
+            }
+            if (line == "COURSE ENROLLMENTS") in_schedules = false;
+            if (!in_schedules || line.empty() || line.compare(0, 7, "Format:") == 0) return;
 
-                students.push_back(student);
-            } catch (const exception& e) {
-                cerr << "Error parsing student on line " << line_number << ": " << e.what() << endl;
-                continue;
+            string_view parts[5];
+            int id = 0;
+            if (splitFields(line, '|', parts, 5) != 5 || !parseInt(parts[0], id)) {
+                cerr << "Warning: Skipping malformed result line " << line_number << ": " << line << endl;
+                return;
             }
-        }
+            auto found = index_of_id.find(id);
+            if (found == index_of_id.end() || listed[found->second]) {
+                cerr << "Warning: Unknown or repeated student on result line " << line_number << ": " << id << endl;
+                return;
+            }
+            uint32_t student_index = found->second;
+            listed[student_index] = 1;
+            order.push_back(student_index);
+            forEachToken(parts[4], ',', [&](string_view course_id) {
+                uint32_t symbol = course_symbols.find(course_id);
+                uint32_t course = symbol < course_of_symbol.size() ? course_of_symbol[symbol] : NO_INDEX;
+                if (course != NO_INDEX && canEnrollInCourse(students[student_index], course)) {
+                    enrollStudent(student_index, course);
+                } else {
+                    rejected++;
+                }
+            });
+            students[student_index].scheduling_successful = meetsSuccessCriteria(students[student_index]);
+        });
 
-        cout << "Loaded " << students.size() << " students" << endl;
+        for (uint32_t i = 0; i < students.size(); i++) {
+            if (!listed[i]) order.push_back(i);
+        }
+        student_order = order;
+        if (rejected > 0) {
+            cerr << "Warning: " << rejected << " previous enrollments no longer fit and were left out" << endl;
+        }
+        *log << "Restored " << (order.size() - count(listed.begin(), listed.end(), 0)) << " student schedules from "
+             << filename << endl;
         return true;
     }
 
-    bool loadCourses(const string& filename) {
-        ifstream file(filename);
-        if (!file.is_open()) {
-            cerr << "Error opening courses file: " << filename << endl;
-            return false;
+    // Reads ADD|student|course, DROP|student|course or
+    // CAPACITY|course|max_students; false if the line is not one of them
+    static bool parseEventLine(string_view line, EventRecord& event) {
+        string_view parts[3];
+        if (splitFields(line, '|', parts, 3) != 3) return false;
+        if (parts[0] == "CAPACITY") {
+            event.kind = EventKind::Capacity;
+            event.course = parts[1];
+            return parseInt(parts[2], event.max_students);
         }
+        if (parts[0] != "ADD" && parts[0] != "DROP") return false;
+        event.kind = parts[0] == "ADD" ? EventKind::Add : EventKind::Drop;
+        event.course = parts[2];
+        return parseInt(parts[1], event.student_id);
+    }
 
-        string line;
-        int line_number = 0;
-        while (getline(file, line)) {
-            line_number++;
-            // Skip comments and empty lines
-            if (line.empty() || line[0] == '#') continue;
+    // An event in the events file format, for messages about records
+    static string eventText(const EventRecord& event) {
+        if (event.kind == EventKind::Capacity) return "CAPACITY|" + event.course + '|' + to_string(event.max_students);
+        return (event.kind == EventKind::Add ? "ADD|" : "DROP|") + to_string(event.student_id) + '|' + event.course;
+    }
 
-            vector<string> parts = split(line, '|');
-            if (parts.size() != 7) {
-                cerr << "Warning: Skipping malformed course line " << line_number << ": " << line << endl;
-                continue;
+    // Applies events to the current schedule in order, then gives affected
+    // students a greedy turn: those who lost courses, and unscheduled
+    // students who prefer a course that now has a free seat. A student is
+    // never re-placed into a course dropped or lost here. forEachEvent
+    // calls handle(event, number, text) per event, with event null for one
+    // that could not be read; unit, number and text only label messages.
+    template <typename ForEachEvent>
+    EventOutcome playEvents(ForEachEvent forEachEvent, const char* unit) {
+        unordered_map<int, uint32_t> index_of_id;
+        for (uint32_t i = 0; i < students.size(); i++) index_of_id[students[i].id] = i;
+
+        EventOutcome outcome;
+        auto touch = [&](uint32_t student_index) {
+            const Student& student = students[student_index];
+            outcome.before.emplace(student_index, make_pair(student.assigned_courses, student.scheduling_successful));
+        };
+        vector<uint32_t> affected;
+        vector<pair<uint32_t, uint32_t>> excluded;
+        vector<uint8_t> freed(courses.size(), 0);
+
+        auto release = [&](uint32_t student_index, uint32_t course_index) {
+            touch(student_index);
+            dropStudent(student_index, course_index);
+            excluded.push_back({student_index, course_index});
+            affected.push_back(student_index);
+            freed[course_index] = 1;
+        };
+
+        forEachEvent([&](const EventRecord* event, int number, string_view text) {
+            uint32_t course_index = NO_INDEX;
+            if (event) {
+                uint32_t symbol = course_symbols.find(event->course);
+                if (symbol < course_of_symbol.size()) course_index = course_of_symbol[symbol];
+            }
+            auto student = event ? index_of_id.find(event->student_id) : index_of_id.end();
+            if (course_index == NO_INDEX || (event->kind != EventKind::Capacity && student == index_of_id.end())) {
+                cerr << "Warning: Skipping invalid event on " << unit << ' ' << number << ": " << text << endl;
+                outcome.refused++;
+                return;
             }
 
-            try {
-                Course course;
-                course.id = parts[0];
-                course.name = parts[1];
-                course.units = stoi(parts[2]);
-                course.max_students = stoi(parts[3]);
-                course.instructor = parts[4];
-                course.room = parts[5];
-
-                // Parse time slots
-                if (!parts[6].empty()) {
-                    vector<string> slot_strings = split(parts[6], ',');
-                    for (const auto& slot_str : slot_strings) {
-                        if (!slot_str.empty()) {
-                            course.time_slots.push_back(parseTimeSlot(slot_str));
-                        }
-                    }
+            if (event->kind == EventKind::Add) {
+                if (!canEnrollInCourse(students[student->second], course_index)) {
+                    cerr << "Event on " << unit << ' ' << number << " refused: " << text << endl;
+                    outcome.refused++;
+                    return;
+                }
+                touch(student->second);
+                enrollStudent(student->second, course_index);
+                if (meetsSuccessCriteria(students[student->second])) students[student->second].scheduling_successful = true;
+            } else if (event->kind == EventKind::Drop) {
+                const auto& held = students[student->second].assigned_courses;
+                if (find(held.begin(), held.end(), course_index) == held.end()) {
+                    cerr << "Event on " << unit << ' ' << number << " refused: " << text << endl;
+                    outcome.refused++;
+                    return;
                 }
+                release(student->second, course_index);
+            } else {
+                Course& course = courses[course_index];
+                course.max_students = max(0, event->max_students);
+                // The most recent enrollments give way first
+                while ((int)course.enrolled_students.size() > course.max_students) {
+                    release(course.enrolled_students.back(), course_index);
+                }
+                freed[course_index] = (int)course.enrolled_students.size() < course.max_students;
+            }
+            outcome.applied++;
+        });
 
-                courses.push_back(course);
-            } catch (const exception& e) {
-                cerr << "Error parsing course on line " << line_number << ": " << e.what() << endl;
-                continue;
+        // Unscheduled students who prefer a freed course, in schedule order
+        for (uint32_t student_index : student_order) {
+            const Student& student = students[student_index];
+            if (student.scheduling_successful) continue;
+            for (uint32_t c : preferences(student)) {
+                if (freed[c]) {
+                    affected.push_back(student_index);
+                    break;
+                }
             }
         }
 
-        // Build course map after all courses are loaded
-        for (size_t i = 0; i < courses.size(); i++) {
-            course_map[courses[i].id] = &courses[i];
+        TurnScratch scratch;
+        prepareScratch(scratch);
+        vector<uint8_t> replaced(students.size(), 0);
+        for (uint32_t student_index : affected) {
+            Student& student = students[student_index];
+            if (replaced[student_index] || student.scheduling_successful) continue;
+            replaced[student_index] = 1;
+            outcome.replaced++;
+            touch(student_index);
+            bool scheduled = studentTurn(student, scratch, [&](uint32_t course_index) {
+                const Course& course = courses[course_index];
+                if ((int)course.enrolled_students.size() >= course.max_students) return false;
+                for (auto [excluded_student, excluded_course] : excluded) {
+                    if (excluded_student == student_index && excluded_course == course_index) return false;
+                }
+                enrollStudent(student_index, course_index);
+                return true;
+            });
+            if (scheduled) student.scheduling_successful = true;
         }
+        return outcome;
+    }
 
-        cout << "Loaded " << courses.size() << " courses" << endl;
-        return true;
+    // Events read from lines of text; comments and blank lines are skipped
+    template <typename Source>
+    EventOutcome playEventLines(Source& source) {
+        return playEvents([&](auto handle) {
+            forEachLine(source, [&](string_view line, int line_number) {
+                if (line.empty() || line[0] == '#') return;
+                EventRecord event;
+                handle(parseEventLine(line, event) ? &event : nullptr, line_number, line);
+            });
+        }, "line");
     }
 
-    bool hasTimeConflict(const Student& student, const Course& course) {
-        // Check if student has unavailable times that conflict with course
-        for (const auto& unavailable : student.unavailable_times) {
-            for (const auto& slot : course.time_slots) {
-                if (unavailable == slot.toString()) {
-                    return true;
+    // Lists every student whose schedule the events changed; returns how
+    // many there are
+    template <typename Output>
+    size_t writeDelta(const EventOutcome& outcome, Output& delta) {
+        delta << "# Incremental scheduling delta: " << outcome.applied << " events applied, " << outcome.refused
+              << " refused\n";
+        delta << "# Format: StudentID|Success|AddedCourses|DroppedCourses\n";
+        size_t changed = 0;
+        for (uint32_t student_index : student_order) {
+            auto previous = outcome.before.find(student_index);
+            if (previous == outcome.before.end()) continue;
+            const Student& student = students[student_index];
+            const vector<uint32_t>& old_courses = previous->second.first;
+            string added, dropped;
+            for (uint32_t c : student.assigned_courses) {
+                if (find(old_courses.begin(), old_courses.end(), c) == old_courses.end()) {
+                    added += (added.empty() ? "" : ",") + string(courses[c].id);
                 }
             }
-        }
-
-        // Check if student's already assigned courses conflict
-        for (const auto& assigned_course_id : student.assigned_courses) {
-            auto assigned_course = course_map[assigned_course_id];
-            for (const auto& assigned_slot : assigned_course->time_slots) {
-                for (const auto& new_slot : course.time_slots) {
-                    if (timeSlotsOverlap(assigned_slot, new_slot)) {
-                        return true;
-                    }
+            for (uint32_t c : old_courses) {
+                if (find(student.assigned_courses.begin(), student.assigned_courses.end(), c) ==
+                    student.assigned_courses.end()) {
+                    dropped += (dropped.empty() ? "" : ",") + string(courses[c].id);
                 }
             }
+            if (added.empty() && dropped.empty() && student.scheduling_successful == previous->second.second) continue;
+            changed++;
+            delta << student.id << '|' << (student.scheduling_successful ? "YES" : "NO") << '|' << added << '|'
+                  << dropped << '\n';
         }
+        return changed;
+    }
 
-        return false;
+    void logEvents(const EventOutcome& outcome, size_t changed) {
+        *log << "Incremental update: " << outcome.applied << " events applied, " << outcome.refused << " refused, "
+             << outcome.replaced << " students re-placed, " << changed << " schedules changed" << endl;
+    }
+
+    // Applies the events of events_file, see playEvents, and lists changed
+    // students in delta_file
+    bool applyEvents(const string& events_file, const string& delta_file) {
+        MappedFile file;
+        if (!file.open(events_file)) {
+            cerr << "Error opening events file: " << events_file << endl;
+            return false;
+        }
+        string_view text = file.view();
+        EventOutcome outcome = playEventLines(text);
+
+        ResultWriter delta;
+        if (!delta.open(delta_file)) {
+            cerr << "Error opening delta file: " << delta_file << endl;
+            return false;
+        }
+        size_t changed = writeDelta(outcome, delta);
+        if (!delta.close()) {
+            cerr << "Error writing delta file: " << delta_file << endl;
+            return false;
+        }
+
+        logEvents(outcome, changed);
+        *log << "Delta saved to " << delta_file << endl;
+        return true;
+    }
+
+    bool applyEvents(istream& events, ostream& delta) {
+        EventOutcome outcome = playEventLines(events);
+        size_t changed = writeDelta(outcome, delta);
+        if (!delta) {
+            cerr << "Error writing the delta stream" << endl;
+            return false;
+        }
+        logEvents(outcome, changed);
+        return true;
+    }
+
+    bool applyEvents(const vector<EventRecord>& events, ostream& delta) {
+        EventOutcome outcome = playEvents([&](auto handle) {
+            for (size_t i = 0; i < events.size(); i++) handle(&events[i], i + 1, eventText(events[i]));
+        }, "record");
+        size_t changed = writeDelta(outcome, delta);
+        if (!delta) {
+            cerr << "Error writing the delta stream" << endl;
+            return false;
+        }
+        logEvents(outcome, changed);
+        return true;
     }
 
-    bool timeSlotsOverlap(const TimeSlot& slot1, const TimeSlot& slot2) {
-        if (slot1.day != slot2.day) return false;
+    // Plays one capacity change against the committed schedule without
+    // writing to it, so trials can run side by side. Students and rosters are
+    // shared by every trial; a trial copies the seat count of each course it
+    // touches and the record of each student it displaces. Added seats go, in
+    // schedule order, to unscheduled students whose turn then ends with them
+    // scheduled in the changed course; other turns are undone, so the gain
+    // is exactly what the new seats bring. Removed seats are taken from the
+    // most recent enrollments as a CAPACITY event does, and the displaced
+    // students take a turn elsewhere.
+    void evaluateCapacityTrial(CapacityTrial& trial, const CapacityBase& base) const {
+        const Course& changed = courses[trial.course];
+        int enrolled = changed.enrolled_students.size();
+        trial.capacity = max(0, changed.max_students + trial.delta);
+        trial.scheduled = base.scheduled;
 
-        // Convert time to minutes for easier comparison
-        auto timeToMinutes = [](const string& time) -> int {
-            try {
-                if (time.length() < 5) return 0; // Invalid time format
-                int hours = stoi(time.substr(0, 2));
-                int minutes = stoi(time.substr(3, 2));
-                return hours * 60 + minutes;
-            } catch (const exception& e) {
-                cerr << "Warning: Invalid time format: " << time << endl;
-                return 0; // Return safe default
+        unordered_map<uint32_t, int> seats_taken;
+        seats_taken[trial.course] = min(enrolled, trial.capacity);
+        vector<uint32_t> claimed;
+        auto claimSeat = [&](uint32_t course_index) {
+            auto taken = seats_taken.try_emplace(course_index, (int)courses[course_index].enrolled_students.size()).first;
+            int capacity = course_index == trial.course ? trial.capacity : courses[course_index].max_students;
+            if (taken->second >= capacity) return false;
+            taken->second++;
+            claimed.push_back(course_index);
+            return true;
+        };
+        // Full courses would only turn the candidate down
+        vector<uint32_t> catalog = base.open_courses;
+        if (!base.open[trial.course]) {
+            catalog.insert(lower_bound(catalog.begin(), catalog.end(), trial.course), trial.course);
+        }
+        TurnScratch scratch;
+        prepareScratch(scratch);
+        scratch.ranked = true;
+        scratch.ranked_catalog.assign(1, {catalog.data(), catalog.data() + catalog.size()});
+        auto trialTurn = [&](const Student& student) {
+            scratch.ranked_preferences.clear();
+            for (uint32_t c : preferences(student)) {
+                if (base.open[c] || c == trial.course) scratch.ranked_preferences.push_back(c);
             }
+            return studentTurn(student, scratch, claimSeat);
         };
 
-        int start1 = timeToMinutes(slot1.start_time);
-        int end1 = timeToMinutes(slot1.end_time);
-        int start2 = timeToMinutes(slot2.start_time);
-        int end2 = timeToMinutes(slot2.end_time);
+        for (int i = enrolled - 1; i >= trial.capacity; i--) {
+            Student student = students[changed.enrolled_students[i]];
+            releaseAssignment(student, trial.course);
+            trial.displaced++;
+            if (!student.scheduling_successful || meetsSuccessCriteria(student)) continue;
+            trial.scheduled--;
+            if (trialTurn(student)) trial.scheduled++;
+        }
 
-        return !(end1 <= start2 || end2 <= start1);
+        for (uint32_t student_index : base.unscheduled) {
+            if (trial.delta <= 0 || seats_taken[trial.course] >= trial.capacity) break;
+            const Student& student = students[student_index];
+            if (!fitsSchedule(student, trial.course)) continue;
+            claimed.clear();
+            if (trialTurn(student) &&
+                find(claimed.begin(), claimed.end(), trial.course) != claimed.end()) {
+                trial.scheduled++;
+            } else {
+                for (uint32_t course_index : claimed) seats_taken[course_index]--;
+            }
+        }
     }
 
-    bool meetsUnitConstraints(const Student& student, const string& course_id) {
-        auto course = course_map[course_id];
-        int new_total = student.total_units + course->units;
+    // Evaluates each trial on its own against the committed schedule, in
+    // parallel, and ranks them by the students they schedule. Returns how
+    // many students the committed schedule has.
+    size_t rankCapacityTrials(vector<CapacityTrial>& trials) {
+        auto started = chrono::steady_clock::now();
+        CapacityBase base;
+        for (uint32_t student_index : student_order) {
+            if (!students[student_index].scheduling_successful) base.unscheduled.push_back(student_index);
+        }
+        base.scheduled = students.size() - base.unscheduled.size();
+        base.open.assign(courses.size(), 0);
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            if ((int)courses[c].enrolled_students.size() >= courses[c].max_students) continue;
+            base.open[c] = 1;
+            base.open_courses.push_back(c);
+        }
 
-        if (new_total > student.max_units) return false;
+        if (thread_count > 1 && trials.size() > 1) {
+            ThreadPool& workers = workerPool();
+            for (auto& trial : trials) {
+                workers.submit([this, &trial, &base] { evaluateCapacityTrial(trial, base); });
+            }
+            workers.wait();
+        } else {
+            for (auto& trial : trials) evaluateCapacityTrial(trial, base);
+        }
 
-        // Check unit type constraints
-        int three_unit_count = 0;
-        int one_unit_count = 0;
+        // Largest gain first; ties keep the order of the changes
+        stable_sort(trials.begin(), trials.end(), [](const CapacityTrial& a, const CapacityTrial& b) {
+            return a.scheduled > b.scheduled;
+        });
+
+        double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        *log << "Capacity what-if: " << trials.size() << " changes evaluated in " << elapsed << " ms";
+        if (!trials.empty()) {
+            *log << ", best " << courses[trials[0].course].id << ' ' << (trials[0].delta > 0 ? "+" : "")
+                 << trials[0].delta << " schedules " << trials[0].scheduled << '/' << students.size();
+        }
+        *log << endl;
+        return base.scheduled;
+    }
 
-        for (const auto& assigned_id : student.assigned_courses) {
-            if (course_map[assigned_id]->units == 3) three_unit_count++;
-            else one_unit_count++;
+    // Evaluates each change on its own, see evaluateCapacityTrial, and ranks
+    // them by the students they schedule. Changes to unknown courses are
+    // listed instead of evaluated.
+    CapacityReport evaluateCapacityChanges(const vector<CapacityChange>& changes) {
+        CapacityReport report;
+        vector<CapacityTrial> trials;
+        for (size_t i = 0; i < changes.size(); i++) {
+            uint32_t symbol = course_symbols.find(changes[i].course);
+            uint32_t course_index = symbol < course_of_symbol.size() ? course_of_symbol[symbol] : NO_INDEX;
+            if (course_index == NO_INDEX) {
+                report.unknown.push_back(i);
+                continue;
+            }
+            trials.push_back({course_index, changes[i].delta, i});
         }
 
-        if (course->units == 3) three_unit_count++;
-        else one_unit_count++;
+        report.scheduled = rankCapacityTrials(trials);
+        for (const CapacityTrial& trial : trials) {
+            report.ranked.push_back({trial.change, trial.course, trial.delta, trial.capacity, trial.scheduled,
+                                     (long long)trial.scheduled - (long long)report.scheduled, trial.displaced});
+        }
+        return report;
+    }
 
-        // At most 2 one-unit courses
-        if (one_unit_count > 2) return false;
+    // Copies the schedule into a snapshot header and body, so the caller can
+    // write it out after letting go of the state
+    vector<uint32_t> snapshotWords(SnapshotHeader& header, uint64_t sequence) const {
+        header = {};
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.sequence = sequence;
+        header.student_count = students.size();
+        header.course_count = courses.size();
 
-        // If we're at min units, check if we have at least 3 three-unit courses
-        if (new_total >= student.min_units && three_unit_count < 3) {
-            return false;
+        vector<uint32_t> words;
+        words.reserve(3 * students.size() + 2 * courses.size());
+        words.insert(words.end(), student_order.begin(), student_order.end());
+        for (const auto& student : students) words.push_back(student.scheduling_successful);
+        for (const auto& student : students) {
+            words.push_back(student.assigned_courses.size());
+            header.assignment_count += student.assigned_courses.size();
+        }
+        for (const auto& course : courses) words.push_back(course.enrolled_students.size());
+        for (const auto& course : courses) words.push_back(course.max_students);
+        for (const auto& student : students) {
+            words.insert(words.end(), student.assigned_courses.begin(), student.assigned_courses.end());
+        }
+        for (const auto& course : courses) {
+            words.insert(words.end(), course.enrolled_students.begin(), course.enrolled_students.end());
         }
+        return words;
+    }
 
+    // Writes a snapshot to a temporary file and renames it into place, so a
+    // crash leaves either the old snapshot or the new one
+    static bool writeSnapshot(const string& filename, const SnapshotHeader& header, const vector<uint32_t>& words) {
+        string temporary = filename + ".tmp";
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool written = fd >= 0 && write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header);
+        const char* bytes = reinterpret_cast<const char*>(words.data());
+        size_t remaining = words.size() * sizeof(uint32_t);
+        while (written && remaining > 0) {
+            ssize_t chunk = write(fd, bytes, remaining);
+            if (chunk < 0 && errno == EINTR) continue;
+            written = chunk > 0;
+            if (written) {
+                bytes += chunk;
+                remaining -= chunk;
+            }
+        }
+        written = written && fdatasync(fd) == 0;
+        if (fd >= 0) ::close(fd);
+        if (!written || rename(temporary.c_str(), filename.c_str()) != 0 || !syncDirectoryOf(filename)) {
+            cerr << "Error writing snapshot: " << filename << endl;
+            return false;
+        }
         return true;
     }
 
-    bool canEnrollInCourse(const Student& student, const Course& course) {
-        // Check if course is full
-        if ((int)course.enrolled_students.size() >= course.max_students) return false;
-
-        // Check if student already enrolled
-        if (find(student.assigned_courses.begin(), student.assigned_courses.end(), course.id)
-            != student.assigned_courses.end()) return false;
+    // Restores enrollments from a snapshot onto students and courses that
+    // hold none yet. Every index and count is checked before anything is
+    // applied, so a damaged snapshot leaves the state untouched.
+    bool loadSnapshot(const string& filename, uint64_t& sequence) {
+        MappedFile file;
+        if (!file.open(filename)) {
+            cerr << "Error opening snapshot: " << filename << endl;
+            return false;
+        }
+        string_view data = file.view();
+        SnapshotHeader header;
+        if (data.size() < sizeof(header)) {
+            cerr << "Error: " << filename << " is not a snapshot" << endl;
+            return false;
+        }
+        memcpy(&header, data.data(), sizeof(header));
+        size_t word_count = 3 * students.size() + 2 * courses.size() + 2 * header.assignment_count;
+        if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION ||
+            header.student_count != students.size() || header.course_count != courses.size() ||
+            header.assignment_count > data.size() || data.size() != sizeof(header) + word_count * sizeof(uint32_t)) {
+            cerr << "Error: " << filename << " does not match this instance" << endl;
+            return false;
+        }
+        vector<uint32_t> words(word_count);
+        memcpy(words.data(), data.data() + sizeof(header), word_count * sizeof(uint32_t));
 
-        // Check time conflicts
-        if (hasTimeConflict(student, course)) return false;
+        const uint32_t* order = words.data();
+        const uint32_t* flags = order + students.size();
+        const uint32_t* assigned_counts = flags + students.size();
+        const uint32_t* roster_counts = assigned_counts + students.size();
+        const uint32_t* capacities = roster_counts + courses.size();
+        const uint32_t* assignments = capacities + courses.size();
+        const uint32_t* rosters = assignments + header.assignment_count;
 
-        // Check unit constraints
-        if (!meetsUnitConstraints(student, course.id)) return false;
+        vector<uint8_t> listed(students.size(), 0);
+        uint64_t assigned_total = 0, enrolled_total = 0;
+        bool valid = true;
+        for (uint32_t i = 0; i < students.size(); i++) {
+            valid = valid && order[i] < students.size() && !listed[order[i]];
+            if (valid) listed[order[i]] = 1;
+            assigned_total += assigned_counts[i];
+        }
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            enrolled_total += roster_counts[c];
+            valid = valid && capacities[c] <= (uint32_t)numeric_limits<int>::max();
+        }
+        valid = valid && assigned_total == header.assignment_count && enrolled_total == header.assignment_count;
+        for (uint64_t k = 0; valid && k < header.assignment_count; k++) {
+            valid = assignments[k] < courses.size() && rosters[k] < students.size();
+        }
+        if (!valid) {
+            cerr << "Error: " << filename << " is damaged" << endl;
+            return false;
+        }
 
+        student_order.assign(order, order + students.size());
+        for (uint32_t i = 0; i < students.size(); i++) {
+            Student& student = students[i];
+            for (uint32_t k = 0; k < assigned_counts[i]; k++) recordAssignment(student, *assignments++);
+            student.scheduling_successful = flags[i] != 0;
+        }
+        for (uint32_t c = 0; c < courses.size(); c++) {
+            courses[c].max_students = capacities[c];
+            courses[c].enrolled_students.assign(rosters, rosters + roster_counts[c]);
+            rosters += roster_counts[c];
+        }
+        sequence = header.sequence;
         return true;
     }
 
-    void scheduleStudents() {
-        cout << "\nStarting scheduling process..." << endl;
+    // A daemon change read back from the journal, applied as the daemon did
+    void replayJournalRecord(JournalRecord record) {
+        uint32_t course_index = record.course & ~JOURNAL_DROP;
+        if (record.student >= students.size() || course_index >= courses.size()) {
+            cerr << "Warning: Skipping invalid journal record" << endl;
+            return;
+        }
+        Student& student = students[record.student];
+        if (record.course & JOURNAL_DROP) {
+            dropStudent(record.student, course_index);
+        } else if (canEnrollInCourse(student, course_index)) {
+            enrollStudent(record.student, course_index);
+            if (meetsSuccessCriteria(student)) student.scheduling_successful = true;
+        } else {
+            cerr << "Warning: Journal enrollment no longer fits: student " << student.id << endl;
+        }
+    }
+
+    // Takes back a daemon change the journal could not make durable and
+    // publishes the result; called holding state_mutex, newest change first,
+    // so every seat it gives back is still free
+    void undoJournalRecord(JournalRecord record) {
+        uint32_t course_index = record.course & ~JOURNAL_DROP;
+        Student& student = students[record.student];
+        if (record.course & JOURNAL_DROP) {
+            enrollStudent(record.student, course_index);
+            student.scheduling_successful = meetsSuccessCriteria(student);
+        } else {
+            dropStudent(record.student, course_index);
+        }
+        publishChange(record.student, course_index);
+    }
 
-        // Shuffle students for fair distribution
-        shuffle(students.begin(), students.end(), rng);
+    // Publishes a served copy of the whole schedule
+    void publishSchedule() {
+        auto copy = make_shared<ServedSchedule>();
+        for (size_t first = 0; first < students.size(); first += ServedSchedule::CHUNK) {
+            size_t last = min(students.size(), first + ServedSchedule::CHUNK);
+            copy->student_chunks.push_back(
+                make_shared<const vector<Student>>(students.begin() + first, students.begin() + last));
+        }
+        for (const auto& course : courses) {
+            copy->rosters.push_back(make_shared<const vector<uint32_t>>(course.enrolled_students));
+        }
+        atomic_store(&served, shared_ptr<const ServedSchedule>(move(copy)));
+    }
 
-        int scheduled_students = 0;
-        int total_enrollments = 0;
+    // Publishes the schedule after a change to one student and course;
+    // called by the writer holding state_mutex
+    void publishChange(uint32_t student_index, uint32_t course_index) {
+        auto copy = make_shared<ServedSchedule>(*atomic_load(&served));
+        size_t chunk = student_index / ServedSchedule::CHUNK;
+        size_t first = chunk * ServedSchedule::CHUNK;
+        size_t last = min(students.size(), first + ServedSchedule::CHUNK);
+        copy->student_chunks[chunk] =
+            make_shared<const vector<Student>>(students.begin() + first, students.begin() + last);
+        copy->rosters[course_index] = make_shared<const vector<uint32_t>>(courses[course_index].enrolled_students);
+        atomic_store(&served, shared_ptr<const ServedSchedule>(move(copy)));
+    }
 
-        for (size_t student_idx = 0; student_idx < students.size(); student_idx++) {
-            auto& student = students[student_idx];
+    // One daemon request line: ENROLL|student|course, DROP|student|course,
+    // FEASIBLE|student or ROSTER|course. Replies are a single line, OK|...
+    // or ERR|reason. Changes go through the same checks as canEnrollInCourse;
+    // queries answer from the served copy. Course capacities, units and
+    // times do not change while serving.
+    string handleRequest(string_view line, const unordered_map<int, uint32_t>& index_of_id) {
+        string_view parts[3];
+        size_t fields = splitFields(line, '|', parts, 3);
+        auto studentIndex = [&](string_view text) {
+            int id = 0;
+            if (!parseInt(text, id)) return NO_INDEX;
+            auto found = index_of_id.find(id);
+            return found == index_of_id.end() ? NO_INDEX : found->second;
+        };
+        auto courseIndex = [&](string_view id) {
+            uint32_t symbol = course_symbols.find(id);
+            return symbol < course_of_symbol.size() ? course_of_symbol[symbol] : NO_INDEX;
+        };
+        string_view command = parts[0];
 
-            // Create a prioritized list of courses based on preferences
-            vector<string> course_priority;
+        if ((command == "ENROLL" || command == "DROP") && fields == 3) {
+            uint32_t student_index = studentIndex(parts[1]);
+            uint32_t course_index = courseIndex(parts[2]);
+            if (student_index == NO_INDEX) return "ERR|unknown student";
+            if (course_index == NO_INDEX) return "ERR|unknown course";
 
-            // First, add preferred courses that are available
-            for (const auto& pref : student.preferred_courses) {
-                if (course_map.find(pref) != course_map.end()) {
-                    course_priority.push_back(pref);
+            string reply;
+            uint64_t sequence = 0;
+            SnapshotHeader snapshot_header;
+            vector<uint32_t> snapshot;
+            bool checkpointing = false;
+            {
+                lock_guard<mutex> lock(state_mutex);
+                if (journal && journal->broken()) return "ERR|journal write failed";
+                Student& student = students[student_index];
+                if (command == "ENROLL") {
+                    if (!canEnrollInCourse(student, course_index)) return "ERR|not allowed";
+                    enrollStudent(student_index, course_index);
+                    if (meetsSuccessCriteria(student)) student.scheduling_successful = true;
+                } else if (!dropStudent(student_index, course_index)) {
+                    return "ERR|not enrolled";
                 }
-            }
+                reply = "OK|" + to_string(student.total_units) + "|" + (student.scheduling_successful ? "YES" : "NO");
+                publishChange(student_index, course_index);
 
-            // Add remaining courses (for students who need more options)
-            for (size_t course_idx = 0; course_idx < courses.size(); course_idx++) {
-                const string& course_id = courses[course_idx].id;
-                if (find(course_priority.begin(), course_priority.end(), course_id) == course_priority.end()) {
-                    course_priority.push_back(course_id);
+                // A checkpoint copies the schedule here and writes it once the
+                // lock is released; one runs at a time
+                if (journal) {
+                    sequence = journal->append({student_index, course_index | (command == "DROP" ? JOURNAL_DROP : 0)});
+                    if (journal->next() - journal->base() >= JOURNAL_CHECKPOINT_RECORDS &&
+                        !checkpoint_running.exchange(true)) {
+                        snapshot = snapshotWords(snapshot_header, journal->next());
+                        checkpointing = true;
+                    }
                 }
             }
 
-            // Try to enroll in courses
-            for (const auto& course_id : course_priority) {
-                // Check if course exists
-                if (course_map.find(course_id) == course_map.end()) {
-                    continue;
+            // Acknowledged only once on disk; writers waiting here share a
+            // sync. When it fails, this change and any made after it are
+            // undone, newest first, so memory matches what was acknowledged.
+            if (journal && !journal->sync(sequence)) {
+                if (checkpointing) checkpoint_running = false;
+                lock_guard<mutex> lock(state_mutex);
+                vector<JournalRecord> lost = journal->discardUnsynced();
+                for (size_t k = lost.size(); k-- > 0;) undoJournalRecord(lost[k]);
+                return "ERR|journal write failed";
+            }
+            if (checkpointing) {
+                if (!writeSnapshot(journal_path + ".snap", snapshot_header, snapshot) ||
+                    !journal->restart(snapshot_header.sequence)) {
+                    cerr << "Warning: Checkpoint failed; the journal keeps growing" << endl;
                 }
+                checkpoint_running = false;
+            }
+            return reply;
+        }
 
-                // Find the course in our courses vector
-                Course* course_ptr = nullptr;
-                for (size_t i = 0; i < courses.size(); i++) {
-                    if (courses[i].id == course_id) {
-                        course_ptr = &courses[i];
-                        break;
-                    }
-                }
+        if (command == "FEASIBLE" && fields == 2) {
+            uint32_t student_index = studentIndex(parts[1]);
+            if (student_index == NO_INDEX) return "ERR|unknown student";
 
-                if (!course_ptr) continue;
-
-                if (canEnrollInCourse(student, *course_ptr)) {
-                    // Enroll student
-                    student.assigned_courses.push_back(course_id);
-                    student.total_units += course_ptr->units;
-                    course_ptr->enrolled_students.push_back(student.id);
-                    total_enrollments++;
-
-                    // Update the course_map pointer
-                    course_map[course_id] = course_ptr;
-
-                    // Check if student has enough units
-                    if (student.total_units >= student.min_units) {
-                        // Verify minimum 3-unit course requirement
-                        int three_unit_count = 0;
-                        for (const auto& assigned_id : student.assigned_courses) {
-                            // Find course safely
-                            for (const auto& c : courses) {
-                                if (c.id == assigned_id && c.units == 3) {
-                                    three_unit_count++;
-                                    break;
-                                }
-                            }
-                        }
+            shared_ptr<const ServedSchedule> schedule = atomic_load(&served);
+            const Student& student = schedule->student(student_index);
+            string reply = "OK|";
+            bool first = true;
+            for (uint32_t c = 0; c < courses.size(); c++) {
+                if ((int)schedule->rosters[c]->size() >= courses[c].max_students || !fitsSchedule(student, c)) continue;
+                if (!first) reply += ',';
+                reply += courses[c].id;
+                first = false;
+            }
+            return reply;
+        }
 
-                        if (three_unit_count >= 3) {
-                            student.scheduling_successful = true;
-                            break;
-                        }
-                    }
-                }
+        if (command == "ROSTER" && fields == 2) {
+            uint32_t course_index = courseIndex(parts[1]);
+            if (course_index == NO_INDEX) return "ERR|unknown course";
 
-                // Stop if at maximum units
-                if (student.total_units >= student.max_units) {
-                    break;
+            shared_ptr<const ServedSchedule> schedule = atomic_load(&served);
+            const vector<uint32_t>& roster = *schedule->rosters[course_index];
+            string reply = "OK|" + to_string(roster.size()) + "|" + to_string(courses[course_index].max_students) + "|";
+            for (size_t i = 0; i < roster.size(); i++) {
+                if (i > 0) reply += ',';
+                reply += to_string(schedule->student(roster[i]).id);
+            }
+            return reply;
+        }
+
+        return "ERR|bad request";
+    }
+
+    static bool sendAll(int socket_fd, const string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t written = send(socket_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            sent += written;
+        }
+        return true;
+    }
+
+    // Answers newline-terminated requests until the client disconnects.
+    // Pipelined requests are answered in order, one reply per read.
+    void serveConnection(int client, const unordered_map<int, uint32_t>& index_of_id, atomic<size_t>& requests) {
+        string pending, replies;
+        char buffer[4096];
+        while (true) {
+            ssize_t got = read(client, buffer, sizeof(buffer));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return;
+            pending.append(buffer, got);
+
+            replies.clear();
+            size_t start = 0, end;
+            while ((end = pending.find('\n', start)) != string::npos) {
+                string_view line(pending.data() + start, end - start);
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                if (!line.empty()) {
+                    replies += handleRequest(line, index_of_id);
+                    replies += '\n';
+                    requests.fetch_add(1, memory_order_relaxed);
                 }
+                start = end + 1;
             }
+            pending.erase(0, start);
+            if (pending.size() > DAEMON_MAX_LINE) replies += "ERR|request too long\n";
+            if (!sendAll(client, replies) || pending.size() > DAEMON_MAX_LINE) return;
+        }
+    }
 
-            if (student.scheduling_successful) {
-                scheduled_students++;
+    // Seed recorded by an existing journal, so a run that died before its
+    // first checkpoint is scheduled again with the same shuffle
+    static bool journalSeed(const string& path, uint32_t& seed) {
+        JournalHeader header;
+        if (!Journal::readHeader(path + ".wal", header)) return false;
+        seed = header.seed;
+        return true;
+    }
+
+    // Setting that makes the schedule depend on timing or thread
+    // interleaving, or nullptr when a seed reproduces it
+    const char* unreproducibleSetting() const {
+        if (engine == Engine::Concurrent && thread_count > 1) return "the concurrent engine on several threads";
+        if (improve_budget_ms > 0) return "an improvement time budget";
+        if (engine == Engine::Exact && exact_time_limit_ms > 0) return "an exact search time limit";
+        return nullptr;
+    }
+
+    // Opens the journal at path. With a snapshot present, the schedule is
+    // restored from it and the journal tail replayed, so the work done
+    // depends on the tail and not on rescheduling the instance. A run lost
+    // before its first snapshot is scheduled again from the journal's seed,
+    // so settings a seed cannot reproduce are refused; records the journal
+    // holds from the start are replayed by checkpoint(), and a journal that
+    // no longer starts at the first change is refused without its snapshot.
+    bool openJournal(const string& path, bool& recovered) {
+        recovered = false;
+        if (const char* setting = unreproducibleSetting()) {
+            cerr << "Error: a journal needs a reproducible schedule, which rules out " << setting << endl;
+            return false;
+        }
+        journal_path = path;
+        journal.reset(new Journal());
+        vector<JournalRecord> tail;
+        if (!journal->open(path + ".wal", seed, tail)) return false;
+
+        struct stat info;
+        if (stat((path + ".snap").c_str(), &info) != 0) {
+            if (journal->base() != 0) {
+                cerr << "Error: Journal " << path << ".wal starts at change " << journal->base()
+                     << " but its snapshot " << path << ".snap is missing" << endl;
+                return false;
+            }
+            if (!tail.empty()) {
+                *log << "Journal " << path << ".wal has no snapshot; scheduling again and replaying "
+                     << tail.size() << " journal records" << endl;
+            }
+            unreplayed = move(tail);
+            return true;
+        }
+
+        auto start = chrono::steady_clock::now();
+        uint64_t covered = 0;
+        if (!loadSnapshot(path + ".snap", covered)) return false;
+        size_t replayed = 0;
+        for (size_t k = 0; k < tail.size(); k++) {
+            if (journal->base() + k < covered) continue;
+            replayJournalRecord(tail[k]);
+            replayed++;
+        }
+        if (journal->next() < covered && !journal->restart(covered)) return false;
+        recovered = true;
+        *log << "Recovered from " << path << ".snap and " << replayed << " journal records in "
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+        return true;
+    }
+
+    // Snapshots the current schedule and empties the journal, first
+    // replaying any records openJournal found without a snapshot. Callers
+    // make sure no change is in progress.
+    bool checkpoint() {
+        if (!journal) return true;
+        for (JournalRecord record : unreplayed) replayJournalRecord(record);
+        unreplayed.clear();
+        SnapshotHeader header;
+        vector<uint32_t> words = snapshotWords(header, journal->next());
+        return writeSnapshot(journal_path + ".snap", header, words) && journal->restart(header.sequence);
+    }
+
+    // Serves the in-memory schedule on a Unix domain socket until SIGINT or
+    // SIGTERM, one thread per connection up to DAEMON_MAX_CONNECTIONS. The
+    // accept loop polls so that it notices the stop flag whichever thread
+    // took the signal; open connections are then shut down, their threads
+    // joined, and the previous signal handlers restored, before returning.
+    bool serve(const string& socket_path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            cerr << "Error: socket path too long: " << socket_path << endl;
+            return false;
+        }
+        memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+        unlink(socket_path.c_str());
+        int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 ||
+            listen(listener, SOMAXCONN) != 0) {
+            cerr << "Error listening on " << socket_path << ": " << strerror(errno) << endl;
+            if (listener >= 0) close(listener);
+            return false;
+        }
+
+        unordered_map<int, uint32_t> index_of_id;
+        for (uint32_t i = 0; i < students.size(); i++) index_of_id[students[i].id] = i;
+
+        publishSchedule();
+        stop_requested = 0;
+        struct sigaction action{}, previous_int{}, previous_term{};
+        action.sa_handler = requestStop;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, &previous_int);
+        sigaction(SIGTERM, &action, &previous_term);
+
+        // Connection threads use this frame, so every one is joined before
+        // serve() returns: a finished thread queues its socket and the
+        // accept loop or the shutdown joins it and closes the socket
+        mutex clients_mutex;
+        condition_variable clients_done;
+        unordered_map<int, thread> clients;
+        vector<int> finished;
+        atomic<size_t> requests(0);
+        size_t connections = 0;
+        auto joinFinished = [&](unique_lock<mutex>& lock) {
+            while (!finished.empty()) {
+                int client = finished.back();
+                finished.pop_back();
+                thread done = move(clients[client]);
+                clients.erase(client);
+                lock.unlock();
+                done.join();
+                close(client);
+                lock.lock();
+            }
+        };
+        *log << "Serving on " << socket_path << endl;
+
+        while (!stop_requested) {
+            {
+                unique_lock<mutex> lock(clients_mutex);
+                joinFinished(lock);
+                if (clients.size() >= DAEMON_MAX_CONNECTIONS) {
+                    clients_done.wait_for(lock, chrono::milliseconds(DAEMON_POLL_MS));
+                    continue;
+                }
             }
+            pollfd waiting = {listener, POLLIN, 0};
+            if (poll(&waiting, 1, DAEMON_POLL_MS) <= 0) continue;
+            int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) continue;
+            connections++;
+            lock_guard<mutex> lock(clients_mutex);
+            clients[client] = thread([&, client] {
+                serveConnection(client, index_of_id, requests);
+                lock_guard<mutex> lock(clients_mutex);
+                finished.push_back(client);
+                clients_done.notify_all();
+            });
         }
 
-        cout << "Scheduling complete!" << endl;
-        cout << "Successfully scheduled: " << scheduled_students << "/" << students.size() << " students" << endl;
-        cout << "Total enrollments: " << total_enrollments << endl;
+        unique_lock<mutex> lock(clients_mutex);
+        for (const auto& entry : clients) shutdown(entry.first, SHUT_RDWR);
+        clients_done.wait(lock, [&] { return finished.size() == clients.size(); });
+        joinFinished(lock);
+        close(listener);
+        unlink(socket_path.c_str());
+        sigaction(SIGINT, &previous_int, nullptr);
+        sigaction(SIGTERM, &previous_term, nullptr);
+        atomic_store(&served, shared_ptr<const ServedSchedule>());
+        *log << "Daemon stopped: " << connections << " connections, " << requests.load() << " requests" << endl;
+        return true;
     }
 
     void saveScheduleToFile(const string& filename) {
-        ofstream file(filename);
-        if (!file.is_open()) {
+        ResultWriter file;
+        if (!file.open(filename)) {
             cerr << "Error opening output file: " << filename << endl;
             return;
         }
 
         // Write summary
-        file << "# Course Scheduling Results" << endl;
-        file << "# Generated schedule for " << students.size() << " students and " << courses.size() << " courses" << endl;
-        file << endl;
+        file << "# Course Scheduling Results\n";
+        file << "# Generated schedule for " << students.size() << " students and " << courses.size() << " courses\n";
+        file << '\n';
 
         int successful = 0;
         int total_enrollments = 0;
@@ -438,53 +4784,80 @@ public:
             total_enrollments += student.assigned_courses.size();
         }
 
-        file << "SUMMARY" << endl;
-        file << "Total Students: " << students.size() << endl;
-        file << "Successfully Scheduled: " << successful << endl;
-        file << "Success Rate: " << (100.0 * successful / students.size()) << "%" << endl;
-        file << "Total Enrollments: " << total_enrollments << endl;
-        file << endl;
+        file << "SUMMARY\n";
+        file << "Total Students: " << students.size() << '\n';
+        file << "Successfully Scheduled: " << successful << '\n';
+        file << "Success Rate: " << (100.0 * successful / students.size()) << "%\n";
+        file << "Total Enrollments: " << total_enrollments << '\n';
+        file << '\n';
 
         // Write student schedules
-        file << "STUDENT SCHEDULES" << endl;
-        file << "Format: StudentID|Name|TotalUnits|Success|AssignedCourses" << endl;
-        file << endl;
+        file << "STUDENT SCHEDULES\n";
+        file << "Format: StudentID|Name|TotalUnits|Success|AssignedCourses\n";
+        file << '\n';
 
-        for (const auto& student : students) {
-            file << student.id << "|" << student.name << "|" << student.total_units << "|"
-                 << (student.scheduling_successful ? "YES" : "NO") << "|";
+        for (uint32_t student_index : student_order) {
+            const Student& student = students[student_index];
+            file << student.id << '|' << student.name << '|' << student.total_units << '|'
+                 << (student.scheduling_successful ? "YES" : "NO") << '|';
 
             for (size_t i = 0; i < student.assigned_courses.size(); i++) {
-                file << student.assigned_courses[i];
-                if (i < student.assigned_courses.size() - 1) file << ",";
+                if (i > 0) file << ',';
+                file << courses[student.assigned_courses[i]].id;
             }
-            file << endl;
+            file << '\n';
         }
 
-        file << endl;
+        file << '\n';
 
         // Write course enrollment data
-        file << "COURSE ENROLLMENTS" << endl;
-        file << "Format: CourseID|Name|Units|EnrolledCount|MaxStudents|EnrolledStudents" << endl;
-        file << endl;
+        file << "COURSE ENROLLMENTS\n";
+        file << "Format: CourseID|Name|Units|EnrolledCount|MaxStudents|EnrolledStudents\n";
+        file << '\n';
 
         for (const auto& course : courses) {
-            file << course.id << "|" << course.name << "|" << course.units << "|"
-                 << course.enrolled_students.size() << "|" << course.max_students << "|";
+            file << course.id << '|' << course.name << '|' << course.units << '|'
+                 << course.enrolled_students.size() << '|' << course.max_students << '|';
 
             for (size_t i = 0; i < course.enrolled_students.size(); i++) {
-                file << course.enrolled_students[i];
-                if (i < course.enrolled_students.size() - 1) file << ",";
+                if (i > 0) file << ',';
+                file << students[course.enrolled_students[i]].id;
             }
-            file << endl;
+            file << '\n';
         }
 
-        file.close();
-        cout << "Schedule saved to " << filename << endl;
+        if (!file.close()) {
+            cerr << "Error writing output file: " << filename << endl;
+            return;
+        }
+        *log << "Schedule saved to " << filename << endl;
+    }
+
+    StudentSchedule schedule(size_t position) const {
+        const Student& student = students[student_order[position]];
+        const uint32_t* first = student.assigned_courses.data();
+        return {student.id, student.name, student.total_units, student.scheduling_successful,
+                first, first + student.assigned_courses.size()};
+    }
+
+    size_t studentCount() const { return students.size(); }
+
+    size_t successfulCount() const {
+        size_t successful = 0;
+        for (const auto& student : students) successful += student.scheduling_successful;
+        return successful;
+    }
+
+    size_t totalEnrollments() const {
+        size_t total = 0;
+        for (const auto& student : students) total += student.assigned_courses.size();
+        return total;
     }
 
+    string_view courseId(uint32_t course) const { return courses[course].id; }
+
     void printStatistics() {
-        cout << "\n=== SCHEDULING STATISTICS ===" << endl;
+        *log << "\n=== SCHEDULING STATISTICS ===" << endl;
 
         int successful = 0;
         int total_units_assigned = 0;
@@ -494,67 +4867,85 @@ public:
         for (const auto& student : students) {
             if (student.scheduling_successful) successful++;
             total_units_assigned += student.total_units;
-
-            for (const auto& course_id : student.assigned_courses) {
-                // Find course safely
-                for (const auto& course : courses) {
-                    if (course.id == course_id) {
-                        if (course.units == 3) three_unit_enrollments++;
-                        else one_unit_enrollments++;
-                        break;
-                    }
-                }
-            }
+            three_unit_enrollments += student.three_unit_count;
+            one_unit_enrollments += student.one_unit_count;
         }
 
-        cout << "Students successfully scheduled: " << successful << "/" << students.size()
+        *log << "Students successfully scheduled: " << successful << "/" << students.size()
              << " (" << (100.0 * successful / students.size()) << "%)" << endl;
-        cout << "Average units per student: " << (double)total_units_assigned / students.size() << endl;
-        cout << "Total 3-unit course enrollments: " << three_unit_enrollments << endl;
-        cout << "Total 1-unit course enrollments: " << one_unit_enrollments << endl;
+        *log << "Average units per student: " << (double)total_units_assigned / students.size() << endl;
+        *log << "Total 3-unit course enrollments: " << three_unit_enrollments << endl;
+        *log << "Total 1-unit course enrollments: " << one_unit_enrollments << endl;
 
-        cout << "\nCourse utilization:" << endl;
+        *log << "\nCourse utilization:" << endl;
         for (const auto& course : courses) {
             double utilization = (double)course.enrolled_students.size() / course.max_students * 100;
-            cout << course.id << ": " << course.enrolled_students.size() << "/"
+            *log << course.id << ": " << course.enrolled_students.size() << "/"
                  << course.max_students << " (" << utilization << "%)" << endl;
         }
     }
 };
 
-int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        cout << "Usage: " << argv[0] << " <students_file> <courses_file>" << endl;
-        cout << "Example: " << argv[0] << " students_case1.txt courses_case1.txt" << endl;
-        return 1;
-    }
+bool Scheduler::load(const vector<StudentRecord>& students, const vector<CourseRecord>& courses) {
+    return impl->loadStudents(students) && impl->loadCourses(courses);
+}
 
-    string students_file = argv[1];
-    string courses_file = argv[2];
+StudentSchedule Scheduler::ScheduleIterator::operator*() const { return impl->schedule(position); }
 
-    // Generate output filename based on input
-    string output_file = "schedule_" + students_file.substr(students_file.find_last_of("/\\") + 1);
-    output_file = output_file.substr(0, output_file.find_last_of('.')) + "_results.txt";
+Scheduler::Scheduler() : impl(new Impl()) {}
+Scheduler::Scheduler(uint32_t seed) : impl(new Impl(seed)) {}
+Scheduler::Scheduler(Scheduler&&) noexcept = default;
+Scheduler& Scheduler::operator=(Scheduler&&) noexcept = default;
+Scheduler::~Scheduler() = default;
 
-    Scheduler scheduler;
+uint32_t Scheduler::randomSeed() const { return impl->randomSeed(); }
+void Scheduler::setThreadCount(size_t threads) { impl->setThreadCount(threads); }
+void Scheduler::setStartCount(size_t starts) { impl->setStartCount(starts); }
+void Scheduler::setImproveBudget(double milliseconds) { impl->setImproveBudget(milliseconds); }
+void Scheduler::setEngine(Engine engine) { impl->setEngine(engine); }
+void Scheduler::setExactLimits(size_t node_limit, double time_limit_ms) { impl->setExactLimits(node_limit, time_limit_ms); }
+void Scheduler::setCandidateScope(CandidateScope scope) { impl->setCandidateScope(scope); }
+void Scheduler::setStudentOrder(StudentOrder order) { impl->setStudentOrder(order); }
+void Scheduler::setLog(ostream* log) { impl->setLog(log); }
 
-    cout << "=== Course Scheduler ===" << endl;
-    cout << "Students file: " << students_file << endl;
-    cout << "Courses file: " << courses_file << endl;
-    cout << "Output file: " << output_file << endl;
-    cout << endl;
+bool Scheduler::loadStudents(const string& filename) { return impl->loadStudents(filename); }
+bool Scheduler::loadCourses(const string& filename) { return impl->loadCourses(filename); }
+bool Scheduler::loadStudentsText(string text) { return impl->loadStudentsText(move(text)); }
+bool Scheduler::loadCoursesText(string text) { return impl->loadCoursesText(move(text)); }
+bool Scheduler::isInstanceFile(const string& filename) { return Impl::isInstanceFile(filename); }
+bool Scheduler::loadInstance(const string& filename) { return impl->loadInstance(filename); }
+bool Scheduler::saveInstance(const string& filename) { return impl->saveInstance(filename); }
 
-    if (!scheduler.loadStudents(students_file)) {
-        return 1;
-    }
+void Scheduler::scheduleStudents() { impl->scheduleStudents(); }
+bool Scheduler::scheduleStream(const string& students_file, const string& output_file, size_t window) {
+    return impl->scheduleStream(students_file, output_file, window);
+}
+bool Scheduler::scheduleStream(istream& students, ostream& results, size_t window) {
+    return impl->scheduleStream(students, results, window);
+}
+bool Scheduler::loadPreviousResults(const string& filename) { return impl->loadPreviousResults(filename); }
+bool Scheduler::applyEvents(const string& events_file, const string& delta_file) {
+    return impl->applyEvents(events_file, delta_file);
+}
+bool Scheduler::applyEvents(istream& events, ostream& delta) { return impl->applyEvents(events, delta); }
+bool Scheduler::applyEvents(const vector<EventRecord>& events, ostream& delta) {
+    return impl->applyEvents(events, delta);
+}
+CapacityReport Scheduler::evaluateCapacityChanges(const vector<CapacityChange>& changes) {
+    return impl->evaluateCapacityChanges(changes);
+}
 
-    if (!scheduler.loadCourses(courses_file)) {
-        return 1;
-    }
+Scheduler::ScheduleIterator Scheduler::begin() const { return ScheduleIterator(impl.get(), 0); }
+Scheduler::ScheduleIterator Scheduler::end() const { return ScheduleIterator(impl.get(), impl->studentCount()); }
+size_t Scheduler::studentCount() const { return impl->studentCount(); }
+size_t Scheduler::successfulCount() const { return impl->successfulCount(); }
+size_t Scheduler::totalEnrollments() const { return impl->totalEnrollments(); }
+string_view Scheduler::courseId(uint32_t course) const { return impl->courseId(course); }
 
-    scheduler.scheduleStudents();
-    scheduler.saveScheduleToFile(output_file);
-    scheduler.printStatistics();
+void Scheduler::saveScheduleToFile(const string& filename) { impl->saveScheduleToFile(filename); }
+void Scheduler::printStatistics() { impl->printStatistics(); }
 
-    return 0;
-}
+bool Scheduler::serve(const string& socket_path) { return impl->serve(socket_path); }
+bool Scheduler::journalSeed(const string& path, uint32_t& seed) { return Impl::journalSeed(path, seed); }
+bool Scheduler::openJournal(const string& path, bool& recovered) { return impl->openJournal(path, recovered); }
+bool Scheduler::checkpoint() { return impl->checkpoint(); }
@@ -0,0 +1,217 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Course scheduling library. A Scheduler takes students and courses from the
+// text files, a compiled instance or memory, runs one of the engines and
+// hands the schedule back through iterators or as a results file. Nothing
+// touches the filesystem unless a file is named. Build with -pthread and link
+// libscheduler.a.
+
+// Courses a student falls back on once their preferences are exhausted
+enum class CandidateScope {
+    Catalog,                                // every course
+    Department                              // courses of their preferred courses' departments
+};
+
+// Order in which the greedy engine visits students and candidate courses
+enum class StudentOrder {
+    Shuffle,                                // random student order, courses in list order
+    Scarcity                                // most constrained student and least contended course first
+};
+
+// Scheduling engines selectable with --engine
+enum class Engine {
+    Greedy,
+    Flow,
+    Exact,
+    Concurrent,
+    Draft
+};
+
+// One line of the courses file
+struct CourseRecord {
+    std::string id;
+    std::string name;
+    int units = 3;
+    int max_students = 0;
+    std::string instructor;
+    std::string room;
+    std::vector<std::string> time_slots;    // "Monday_09:00-10:00:1"
+};
+
+// One line of the students file
+struct StudentRecord {
+    int id = 0;
+    std::string name;
+    int min_units = 0;
+    int max_units = 0;
+    std::vector<std::string> preferred_courses;
+    std::vector<std::string> unavailable_times; // "Monday_09:00-10:00"
+};
+
+// Kinds of change in an events file
+enum class EventKind {
+    Add,                                    // ADD|student|course
+    Drop,                                   // DROP|student|course
+    Capacity                                // CAPACITY|course|max_students
+};
+
+// One line of an events file
+struct EventRecord {
+    EventKind kind = EventKind::Add;
+    int student_id = 0;                     // Add and Drop
+    std::string course;
+    int max_students = 0;                   // Capacity
+};
+
+// Seats to add to a course, or to remove when delta is negative
+struct CapacityChange {
+    std::string course;
+    int delta = 0;
+};
+
+// What one capacity change would do to the schedule
+struct CapacityGain {
+    size_t change;                          // index into the changes evaluated
+    uint32_t course;                        // see Scheduler::courseId
+    int delta;
+    int max_students;                       // capacity with the change
+    size_t scheduled;                       // students scheduled with the change
+    long long gain;                         // against CapacityReport::scheduled
+    size_t displaced;                       // enrollments the change took away
+};
+
+struct CapacityReport {
+    size_t scheduled = 0;                   // students the current schedule has
+    std::vector<CapacityGain> ranked;       // largest gain first, ties in input order
+    std::vector<size_t> unknown;            // changes naming no course
+};
+
+// A student's outcome. Views and course pointers stay valid until the
+// schedule changes; courses holds course indices, see Scheduler::courseId.
+struct StudentSchedule {
+    int id;
+    std::string_view name;
+    int total_units;
+    bool successful;
+    const uint32_t* first_course;
+    const uint32_t* last_course;
+
+    const uint32_t* begin() const { return first_course; }
+    const uint32_t* end() const { return last_course; }
+};
+
+class Scheduler {
+public:
+    class Impl;
+
+    // Students in output order. Schedules are made on dereference and
+    // returned by value, so this is an input iterator.
+    class ScheduleIterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = StudentSchedule;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const StudentSchedule*;
+        using reference = StudentSchedule;
+
+        ScheduleIterator(const Impl* impl, size_t position) : impl(impl), position(position) {}
+        StudentSchedule operator*() const;
+        ScheduleIterator& operator++() {
+            position++;
+            return *this;
+        }
+        ScheduleIterator operator++(int) {
+            ScheduleIterator previous = *this;
+            position++;
+            return previous;
+        }
+        bool operator==(const ScheduleIterator& other) const { return position == other.position; }
+        bool operator!=(const ScheduleIterator& other) const { return position != other.position; }
+
+    private:
+        const Impl* impl;
+        size_t position;
+    };
+
+    Scheduler();
+    explicit Scheduler(uint32_t seed);
+    Scheduler(Scheduler&&) noexcept;
+    Scheduler& operator=(Scheduler&&) noexcept;
+    ~Scheduler();
+
+    // Seed of the shuffle; rerunning with the same seed and input reproduces
+    // the schedule exactly
+    uint32_t randomSeed() const;
+
+    void setThreadCount(size_t threads);
+    void setStartCount(size_t starts);
+    void setImproveBudget(double milliseconds);
+    void setEngine(Engine engine);
+    void setExactLimits(size_t node_limit, double time_limit_ms);
+    void setCandidateScope(CandidateScope scope);
+    void setStudentOrder(StudentOrder order);
+
+    // Progress messages go to log; nullptr silences them. Errors and input
+    // warnings always go to std::cerr.
+    void setLog(std::ostream* log);
+
+    // Input, students before courses
+    bool loadStudents(const std::string& filename);
+    bool loadCourses(const std::string& filename);
+    bool loadStudentsText(std::string text);
+    bool loadCoursesText(std::string text);
+    bool load(const std::vector<StudentRecord>& students, const std::vector<CourseRecord>& courses);
+    static bool isInstanceFile(const std::string& filename);
+    bool loadInstance(const std::string& filename);
+    bool saveInstance(const std::string& filename);
+
+    void scheduleStudents();
+
+    // Schedules students as they arrive and writes the results as it goes.
+    // A results stream must be seekable, such as a file or string stream,
+    // because the SUMMARY is filled in once the students run out. A window
+    // of zero is rejected.
+    bool scheduleStream(const std::string& students_file, const std::string& output_file, size_t window);
+    bool scheduleStream(std::istream& students, std::ostream& results, size_t window);
+
+    bool loadPreviousResults(const std::string& filename);
+
+    // Applies events to the schedule and writes the students they changed
+    bool applyEvents(const std::string& events_file, const std::string& delta_file);
+    bool applyEvents(std::istream& events, std::ostream& delta);
+    bool applyEvents(const std::vector<EventRecord>& events, std::ostream& delta);
+
+    // Ranks capacity changes by how many more students each would schedule,
+    // starting from the current schedule, which is left as is
+    CapacityReport evaluateCapacityChanges(const std::vector<CapacityChange>& changes);
+
+    ScheduleIterator begin() const;
+    ScheduleIterator end() const;
+    size_t studentCount() const;
+    size_t successfulCount() const;
+    size_t totalEnrollments() const;
+    std::string_view courseId(uint32_t course) const;
+
+    void saveScheduleToFile(const std::string& filename);
+    void printStatistics();
+
+    bool serve(const std::string& socket_path);
+    static bool journalSeed(const std::string& path, uint32_t& seed);
+    bool openJournal(const std::string& path, bool& recovered);
+    bool checkpoint();
+
+private:
+    std::unique_ptr<Impl> impl;
+};
+
+#endif
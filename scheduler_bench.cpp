@@ -0,0 +1,264 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <cerrno>
+#include <sstream>
+#include <iomanip>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Benchmark harness for the scheduler: generates scaled instances, runs
+// ./scheduler several times per size with fixed seeds and reports median and
+// p95 wall time plus throughput for the load, schedule and write phases.
+
+struct BenchConfig {
+    vector<int> sizes = {1000, 10000, 100000, 1000000};
+    int runs = 5;
+    uint32_t seed = 12345;
+    int threads = 1;
+    string scheduler = "./scheduler";
+    string data_dir = "bench_data";
+};
+
+struct PhaseTimes {
+    double load_ms = 0;
+    double schedule_ms = 0;
+    double write_ms = 0;
+};
+
+class InstanceGenerator {
+private:
+    mt19937 rng;
+
+    vector<string> first_names = {
+        "Alice", "Bob", "Charlie", "Diana", "Edward", "Fiona", "George", "Hannah",
+        "Ivan", "Julia", "Kevin", "Laura", "Michael", "Nina", "Oscar", "Paula"
+    };
+
+    vector<string> last_names = {
+        "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia", "Miller",
+        "Davis", "Rodriguez", "Martinez", "Hernandez", "Lopez", "Gonzalez"
+    };
+
+    vector<string> days = {"Monday", "Tuesday", "Wednesday", "Thursday", "Friday"};
+
+    static string hourSlot(const string& day, int hour) {
+        ostringstream slot;
+        slot << day << "_" << setw(2) << setfill('0') << hour << ":00-"
+             << setw(2) << setfill('0') << hour + 1 << ":00";
+        return slot.str();
+    }
+
+public:
+    explicit InstanceGenerator(uint32_t seed) : rng(seed) {}
+
+    // Catalog grows with the cohort up to 2000 three-unit sections, with
+    // seats for roughly 3.5 course enrollments per student so that larger
+    // instances stay contended
+    void generate(int num_students, const string& students_file, const string& courses_file) {
+        int num_3unit = min(max(num_students / 100, 12), 2000);
+        int num_1unit = max(num_3unit / 3, 4);
+        int seats = max(10, (int)ceil(num_students * 3.5 / (num_3unit + num_1unit)));
+
+        vector<string> slots;
+        for (const auto& day : days) {
+            for (int hour = 8; hour < 17; hour++) slots.push_back(hourSlot(day, hour));
+        }
+        uniform_int_distribution<> slot_dist(0, slots.size() - 1);
+
+        ofstream courses(courses_file);
+        courses << "# Benchmark courses - " << num_students << " students" << endl;
+        courses << "# Format: ID|Name|Units|MaxStudents|Instructor|Room|TimeSlots" << endl;
+        for (int i = 1; i <= num_3unit; i++) {
+            courses << "COURSE3_" << i << "|Advanced Course " << i << "|3|" << seats
+                    << "|Dr. Smith|Room A101|";
+            for (int j = 0; j < 3; j++) {
+                courses << slots[slot_dist(rng)] << ":" << (j == 2 ? 3 : 1) << (j < 2 ? "," : "");
+            }
+            courses << "\n";
+        }
+        for (int i = 1; i <= num_1unit; i++) {
+            courses << "COURSE1_" << i << "|Elective Course " << i << "|1|" << seats
+                    << "|Prof. Brown|Lab C301|" << slots[slot_dist(rng)] << ":1\n";
+        }
+
+        uniform_int_distribution<> first_dist(0, first_names.size() - 1);
+        uniform_int_distribution<> last_dist(0, last_names.size() - 1);
+        uniform_int_distribution<> range_dist(0, 3);
+        uniform_int_distribution<> pref_count_dist(3, 6);
+        uniform_int_distribution<> course3_dist(1, num_3unit);
+        uniform_int_distribution<> course1_dist(1, num_1unit);
+        uniform_int_distribution<> percent_dist(0, 99);
+        // Same full-time, part-time, heavy and light loads as student_generator;
+        // light-load students can only succeed at 9 units (three 3-unit courses)
+        const pair<int, int> unit_ranges[] = {{12, 15}, {9, 12}, {15, 18}, {6, 9}};
+
+        ofstream students(students_file);
+        students << "# Benchmark students - " << num_students << " students" << endl;
+        students << "# Format: ID|Name|MinUnits|MaxUnits|PreferredCourses|UnavailableTimes" << endl;
+        for (int i = 1; i <= num_students; i++) {
+            auto range = unit_ranges[range_dist(rng)];
+            students << i << "|" << first_names[first_dist(rng)] << " " << last_names[last_dist(rng)]
+                     << "|" << range.first << "|" << range.second << "|";
+
+            int num_prefs = pref_count_dist(rng);
+            for (int j = 0; j < num_prefs; j++) {
+                if (j > 0) students << ",";
+                if (percent_dist(rng) < 80) students << "COURSE3_" << course3_dist(rng);
+                else students << "COURSE1_" << course1_dist(rng);
+            }
+            students << "|";
+
+            if (percent_dist(rng) < 30) students << slots[slot_dist(rng)];
+            students << "\n";
+        }
+    }
+};
+
+// Parses a whole decimal number in [1, limit]; false on garbage or out of range
+static bool parsePositive(const string& text, long limit, int& value) {
+    char* end = nullptr;
+    errno = 0;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || errno == ERANGE || parsed < 1 || parsed > limit) return false;
+    value = (int)parsed;
+    return true;
+}
+
+static bool parseSizes(const string& list, vector<int>& sizes) {
+    sizes.clear();
+    stringstream ss(list);
+    string token;
+    while (getline(ss, token, ',')) {
+        int size = 0;
+        if (!parsePositive(token, 100000000, size)) return false;
+        sizes.push_back(size);
+    }
+    return !sizes.empty();
+}
+
+// Runs the scheduler once and extracts the TIMING line from its output
+static bool runScheduler(const BenchConfig& config, const string& students_file,
+                         const string& courses_file, uint32_t seed, PhaseTimes& times) {
+    string command = config.scheduler + " --timing --seed " + to_string(seed) +
+                     " --threads " + to_string(config.threads) + " " +
+                     students_file + " " + courses_file + " 2>&1";
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) return false;
+
+    char line[4096];
+    bool found = false;
+    while (fgets(line, sizeof(line), pipe)) {
+        if (sscanf(line, "TIMING load_ms=%lf schedule_ms=%lf write_ms=%lf",
+                   &times.load_ms, &times.schedule_ms, &times.write_ms) == 3) {
+            found = true;
+        }
+    }
+    return pclose(pipe) == 0 && found;
+}
+
+static double percentile(vector<double> values, double fraction) {
+    sort(values.begin(), values.end());
+    size_t rank = (size_t)ceil(fraction * values.size());
+    return values[rank == 0 ? 0 : rank - 1];
+}
+
+static void report(int students, const string& phase, const vector<double>& samples) {
+    double median = percentile(samples, 0.5);
+    double p95 = percentile(samples, 0.95);
+    cout << left << setw(10) << students << setw(10) << phase << right << fixed << setprecision(2)
+         << setw(12) << median << setw(12) << p95
+         << setw(16) << setprecision(0) << (median > 0 ? students / (median / 1000.0) : 0) << endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            if (!parseSizes(argv[++i], config.sizes)) {
+                cerr << "Invalid sizes: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--runs" && i + 1 < argc) {
+            if (!parsePositive(argv[++i], 1000000, config.runs)) {
+                cerr << "Invalid run count: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            char* end = nullptr;
+            config.seed = strtoul(argv[++i], &end, 10);
+            if (*end != '\0') {
+                cerr << "Invalid seed: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--threads" && i + 1 < argc) {
+            if (!parsePositive(argv[++i], 1024, config.threads)) {
+                cerr << "Invalid thread count: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--scheduler" && i + 1 < argc) {
+            config.scheduler = argv[++i];
+        } else {
+            cout << "Usage: " << argv[0] << " [--sizes 1000,10000,...] [--runs N] [--seed N]"
+                 << " [--threads N] [--scheduler PATH]" << endl;
+            return 1;
+        }
+    }
+
+    // The scheduler writes its result next to the working directory, so
+    // runs happen inside the data directory
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd))) return 1;
+    if (config.scheduler.find('/') != string::npos && config.scheduler[0] != '/') {
+        config.scheduler = string(cwd) + "/" + config.scheduler;
+    }
+    mkdir(config.data_dir.c_str(), 0755);
+    if (chdir(config.data_dir.c_str()) != 0) {
+        cerr << "Error entering " << config.data_dir << endl;
+        return 1;
+    }
+
+    cout << "=== Scheduler Benchmark ===" << endl;
+    cout << "Runs per size: " << config.runs << ", seed: " << config.seed
+         << ", threads: " << config.threads << endl << endl;
+    cout << left << setw(10) << "Students" << setw(10) << "Phase" << right << setw(12) << "Median ms"
+         << setw(12) << "P95 ms" << setw(16) << "Students/s" << endl;
+    cout << string(60, '-') << endl;
+
+    for (int size : config.sizes) {
+        string students_file = "bench_students_" + to_string(size) + ".txt";
+        string courses_file = "bench_courses_" + to_string(size) + ".txt";
+        InstanceGenerator(config.seed + size).generate(size, students_file, courses_file);
+
+        vector<double> load, schedule, write, total;
+        for (int run = 0; run < config.runs; run++) {
+            PhaseTimes times;
+            if (!runScheduler(config, students_file, courses_file, config.seed + run, times)) {
+                cerr << "Scheduler run failed for " << size << " students" << endl;
+                return 1;
+            }
+            load.push_back(times.load_ms);
+            schedule.push_back(times.schedule_ms);
+            write.push_back(times.write_ms);
+            total.push_back(times.load_ms + times.schedule_ms + times.write_ms);
+        }
+
+        report(size, "load", load);
+        report(size, "schedule", schedule);
+        report(size, "write", write);
+        report(size, "total", total);
+        cout << string(60, '-') << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,416 @@
+#include "scheduler.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace std;
+
+// Command-line front end over libscheduler
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options] <students_file> <courses_file>" << endl;
+    cout << "       " << program << " [options] <instance_file>" << endl;
+    cout << "Example: " << program << " students_case1.txt courses_case1.txt" << endl;
+    cout << endl;
+    cout << "Options:" << endl;
+    cout << "  --threads N       Worker threads for parallel phases (0 = all cores, default 1)" << endl;
+    cout << "  --compile FILE    Compile the text inputs into an instance file and exit" << endl;
+    cout << "  --seed N          Seed the student shuffle (default: random, printed)" << endl;
+    cout << "  --starts K        Run K independently shuffled greedy passes in parallel and" << endl;
+    cout << "                    keep the best (0 = one per thread, default 1)" << endl;
+    cout << "  --engine NAME     Scheduling engine: greedy (default), flow, exact," << endl;
+    cout << "                    concurrent or draft" << endl;
+    cout << "  --exact-nodes N   Node limit for the exact engine (0 = none, default 10000000)" << endl;
+    cout << "  --exact-ms MS     Time limit for the exact engine (0 = none, default)" << endl;
+    cout << "  --candidates S    Courses tried after preferences: catalog (default) or" << endl;
+    cout << "                    department; only department splits the instance into" << endl;
+    cout << "                    independent components scheduled in parallel by --threads" << endl;
+    cout << "  --order NAME      Greedy visiting order: shuffle (default) or scarcity, most" << endl;
+    cout << "                    constrained student and least contended course first" << endl;
+    cout << "  --stream          Schedule students as the file is read, through a lottery" << endl;
+    cout << "                    window, writing results as they are placed" << endl;
+    cout << "  --window N        Lottery window size for --stream (default 4096)" << endl;
+    cout << "  --previous FILE   Restore an earlier results file instead of scheduling and" << endl;
+    cout << "                    apply the --events FILE changes to it incrementally" << endl;
+    cout << "  --events FILE     ADD|student|course, DROP|student|course and" << endl;
+    cout << "                    CAPACITY|course|max lines for --previous" << endl;
+    cout << "  --what-if FILE    Rank the course|delta capacity changes in FILE, such as" << endl;
+    cout << "                    COURSE3_2|+5, by the students each would add to the schedule" << endl;
+    cout << "  --improve-ms MS   Spend up to MS milliseconds improving the greedy schedule" << endl;
+    cout << "  --serve SOCKET    After scheduling, answer ENROLL, DROP, FEASIBLE and ROSTER" << endl;
+    cout << "                    requests on a Unix socket until SIGINT or SIGTERM" << endl;
+    cout << "  --journal PATH    Keep a snapshot (PATH.snap) and change journal (PATH.wal);" << endl;
+    cout << "                    an existing one is recovered instead of scheduling again," << endl;
+    cout << "                    so --previous and --events cannot be combined with it" << endl;
+    cout << "  --timing          Print load/schedule/write wall times as a TIMING line" << endl;
+}
+
+static double millisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// A line of a --what-if file, kept for messages about the change it holds
+struct ChangeLine {
+    int number;
+    string text;
+};
+
+// Reads the course|delta lines of a --what-if file, skipping comments and
+// blank lines and warning about malformed ones
+static bool readCapacityChanges(const string& filename, vector<CapacityChange>& changes, vector<ChangeLine>& lines) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error opening capacity changes file: " << filename << endl;
+        return false;
+    }
+    string line;
+    for (int number = 1; getline(file, line); number++) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        // A leading integer, as the input files are read
+        size_t separator = line.find('|');
+        size_t pos = separator == string::npos ? string::npos : line.find_first_not_of(" \t", separator + 1);
+        if (pos != string::npos && line[pos] == '+') pos++;
+        CapacityChange change;
+        if (pos == string::npos || line.find('|', separator + 1) != string::npos ||
+            from_chars(line.data() + pos, line.data() + line.size(), change.delta).ec != errc()) {
+            cerr << "Warning: Skipping invalid capacity change on line " << number << ": " << line << endl;
+            continue;
+        }
+        change.course = line.substr(0, separator);
+        changes.push_back(change);
+        lines.push_back({number, line});
+    }
+    return true;
+}
+
+// Writes the ranking of a capacity what-if, one change per line
+static bool writeCapacityReport(const Scheduler& scheduler, const CapacityReport& result, const string& filename) {
+    ofstream report(filename);
+    if (!report.is_open()) {
+        cerr << "Error opening capacity report: " << filename << endl;
+        return false;
+    }
+    report << "# Capacity what-if: " << result.ranked.size() << " changes against " << result.scheduled << '/'
+           << scheduler.studentCount() << " students scheduled\n";
+    report << "# Format: Rank|Course|Delta|MaxStudents|Scheduled|Gain|Displaced\n";
+    for (size_t i = 0; i < result.ranked.size(); i++) {
+        const CapacityGain& gain = result.ranked[i];
+        report << i + 1 << '|' << scheduler.courseId(gain.course) << '|' << (gain.delta > 0 ? "+" : "") << gain.delta
+               << '|' << gain.max_students << '|' << gain.scheduled << '|' << (gain.gain > 0 ? "+" : "") << gain.gain
+               << '|' << gain.displaced << '\n';
+    }
+    report.close();
+    if (!report) {
+        cerr << "Error writing capacity report: " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> positional;
+    size_t threads = 1;
+    string compile_file;
+    bool has_seed = false;
+    uint32_t seed = 0;
+    bool timing = false;
+    size_t starts = 1;
+    double improve_ms = 0;
+    Engine engine = Engine::Greedy;
+    size_t exact_nodes = 10000000;
+    CandidateScope candidate_scope = CandidateScope::Catalog;
+    StudentOrder student_order = StudentOrder::Shuffle;
+    bool stream = false;
+    string previous_file;
+    string events_file;
+    string serve_socket;
+    string journal_path;
+    string what_if_file;
+    size_t window = 4096;
+    double exact_ms = 0;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            char* end = nullptr;
+            threads = strtoul(argv[++i], &end, 10);
+            if (*end != '\0') {
+                cerr << "Invalid thread count: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--compile" && i + 1 < argc) {
+            compile_file = argv[++i];
+        } else if (arg == "--seed" && i + 1 < argc) {
+            char* end = nullptr;
+            seed = strtoul(argv[++i], &end, 10);
+            if (*end != '\0') {
+                cerr << "Invalid seed: " << argv[i] << endl;
+                return 1;
+            }
+            has_seed = true;
+        } else if (arg == "--starts" && i + 1 < argc) {
+            char* end = nullptr;
+            starts = strtoul(argv[++i], &end, 10);
+            if (*end != '\0') {
+                cerr << "Invalid start count: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--engine" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "greedy") {
+                engine = Engine::Greedy;
+            } else if (name == "flow") {
+                engine = Engine::Flow;
+            } else if (name == "exact") {
+                engine = Engine::Exact;
+            } else if (name == "concurrent") {
+                engine = Engine::Concurrent;
+            } else if (name == "draft") {
+                engine = Engine::Draft;
+            } else {
+                cerr << "Unknown engine: " << name << endl;
+                return 1;
+            }
+        } else if (arg == "--candidates" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "catalog") {
+                candidate_scope = CandidateScope::Catalog;
+            } else if (name == "department") {
+                candidate_scope = CandidateScope::Department;
+            } else {
+                cerr << "Unknown candidate scope: " << name << endl;
+                return 1;
+            }
+        } else if (arg == "--order" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "shuffle") {
+                student_order = StudentOrder::Shuffle;
+            } else if (name == "scarcity") {
+                student_order = StudentOrder::Scarcity;
+            } else {
+                cerr << "Unknown order: " << name << endl;
+                return 1;
+            }
+        } else if (arg == "--previous" && i + 1 < argc) {
+            previous_file = argv[++i];
+        } else if (arg == "--events" && i + 1 < argc) {
+            events_file = argv[++i];
+        } else if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "--window" && i + 1 < argc) {
+            char* end = nullptr;
+            window = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || window == 0) {
+                cerr << "Invalid window size: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--exact-nodes" && i + 1 < argc) {
+            char* end = nullptr;
+            exact_nodes = strtoull(argv[++i], &end, 10);
+            if (*end != '\0') {
+                cerr << "Invalid node limit: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--exact-ms" && i + 1 < argc) {
+            char* end = nullptr;
+            exact_ms = strtod(argv[++i], &end);
+            if (*end != '\0' || exact_ms < 0) {
+                cerr << "Invalid time limit: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--improve-ms" && i + 1 < argc) {
+            char* end = nullptr;
+            improve_ms = strtod(argv[++i], &end);
+            if (*end != '\0' || improve_ms < 0) {
+                cerr << "Invalid improvement budget: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serve_socket = argv[++i];
+        } else if (arg == "--journal" && i + 1 < argc) {
+            journal_path = argv[++i];
+        } else if (arg == "--what-if" && i + 1 < argc) {
+            what_if_file = argv[++i];
+        } else if (arg == "--timing") {
+            timing = true;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            cerr << "Unknown option: " << arg << endl;
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    bool compiled_input = positional.size() == 1;
+    if ((positional.size() != 2 && !(compiled_input && compile_file.empty())) ||
+        previous_file.empty() != events_file.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    string students_file = positional[0];
+    string courses_file = compiled_input ? "" : positional[1];
+
+    // Generate output filename based on input
+    string output_file = "schedule_" + students_file.substr(students_file.find_last_of("/\\") + 1);
+    output_file = output_file.substr(0, output_file.find_last_of('.')) + "_results.txt";
+
+    // A journal keeps the seed of the run that started it
+    uint32_t journal_seed = 0;
+    if (!journal_path.empty() && Scheduler::journalSeed(journal_path, journal_seed)) {
+        seed = journal_seed;
+        has_seed = true;
+    }
+
+    Scheduler scheduler = has_seed ? Scheduler(seed) : Scheduler();
+    scheduler.setThreadCount(threads);
+    scheduler.setStartCount(starts);
+    scheduler.setImproveBudget(improve_ms);
+    scheduler.setEngine(engine);
+    scheduler.setExactLimits(exact_nodes, exact_ms);
+    scheduler.setCandidateScope(candidate_scope);
+    scheduler.setStudentOrder(student_order);
+
+    if (!compile_file.empty()) {
+        if (!scheduler.loadStudents(students_file) || !scheduler.loadCourses(courses_file) ||
+            !scheduler.saveInstance(compile_file)) {
+            return 1;
+        }
+        return 0;
+    }
+
+    // Only department scope splits a single greedy pass into components;
+    // in catalog scope extra threads help loading but not scheduling
+    if (threads != 1 && engine == Engine::Greedy && starts == 1 && !stream &&
+        candidate_scope == CandidateScope::Catalog) {
+        cerr << "Warning: --threads splits the greedy schedule only with --candidates department;"
+             << " catalog scope schedules on one thread" << endl;
+    }
+
+    cout << "=== Course Scheduler ===" << endl;
+    if (compiled_input) {
+        cout << "Instance file: " << students_file << endl;
+    } else {
+        cout << "Students file: " << students_file << endl;
+        cout << "Courses file: " << courses_file << endl;
+    }
+    cout << "Output file: " << output_file << endl;
+    cout << "Random seed: " << scheduler.randomSeed() << endl;
+    cout << endl;
+
+    auto phase_start = chrono::steady_clock::now();
+    if (stream) {
+        // Parsing, scheduling and writing overlap, so they are timed together
+        if (compiled_input) {
+            cerr << "Error: --stream reads a students file, not a compiled instance" << endl;
+            return 1;
+        }
+        if (!serve_socket.empty() || !journal_path.empty() || !what_if_file.empty()) {
+            cerr << "Error: --serve, --journal and --what-if need the whole instance in memory, not a stream" << endl;
+            return 1;
+        }
+        if (!scheduler.loadCourses(courses_file)) {
+            return 1;
+        }
+        double load_ms = millisecondsSince(phase_start);
+        phase_start = chrono::steady_clock::now();
+        if (!scheduler.scheduleStream(students_file, output_file, window)) {
+            return 1;
+        }
+        if (timing) {
+            cout << "TIMING load_ms=" << load_ms << " schedule_ms=" << millisecondsSince(phase_start)
+                 << " write_ms=0" << endl;
+        }
+        return 0;
+    }
+
+    if (compiled_input) {
+        if (!Scheduler::isInstanceFile(students_file)) {
+            cerr << "Error: " << students_file << " is not a compiled instance file" << endl;
+            return 1;
+        }
+        if (!scheduler.loadInstance(students_file)) {
+            return 1;
+        }
+    } else {
+        if (!scheduler.loadStudents(students_file)) {
+            return 1;
+        }
+
+        if (!scheduler.loadCourses(courses_file)) {
+            return 1;
+        }
+    }
+
+    double load_ms = millisecondsSince(phase_start);
+
+    phase_start = chrono::steady_clock::now();
+    bool recovered = false;
+    if (!journal_path.empty() && !scheduler.openJournal(journal_path, recovered)) {
+        return 1;
+    }
+    if (recovered && !previous_file.empty()) {
+        cerr << "Error: --previous and --events cannot change a recovered journal; its snapshot already holds"
+             << " the schedule they would replace" << endl;
+        return 1;
+    }
+    if (recovered) {
+        // The journal already holds the outcome of scheduling and events
+    } else if (!previous_file.empty()) {
+        string delta_file = output_file.substr(0, output_file.rfind("_results.txt")) + "_delta.txt";
+        if (!scheduler.loadPreviousResults(previous_file) || !scheduler.applyEvents(events_file, delta_file)) {
+            return 1;
+        }
+    } else {
+        scheduler.scheduleStudents();
+    }
+    if (!recovered && !scheduler.checkpoint()) {
+        return 1;
+    }
+    double schedule_ms = millisecondsSince(phase_start);
+
+    if (!what_if_file.empty()) {
+        string report_file = output_file.substr(0, output_file.rfind("_results.txt")) + "_what_if.txt";
+        vector<CapacityChange> changes;
+        vector<ChangeLine> lines;
+        if (!readCapacityChanges(what_if_file, changes, lines)) {
+            return 1;
+        }
+        CapacityReport result = scheduler.evaluateCapacityChanges(changes);
+        for (size_t change : result.unknown) {
+            cerr << "Warning: Skipping invalid capacity change on line " << lines[change].number << ": "
+                 << lines[change].text << endl;
+        }
+        if (!writeCapacityReport(scheduler, result, report_file)) {
+            return 1;
+        }
+        cout << "Capacity report saved to " << report_file << endl;
+    }
+
+    // The results file then reflects every change made through the daemon
+    if (!serve_socket.empty() && (!scheduler.serve(serve_socket) || !scheduler.checkpoint())) {
+        return 1;
+    }
+
+    phase_start = chrono::steady_clock::now();
+    scheduler.saveScheduleToFile(output_file);
+    double write_ms = millisecondsSince(phase_start);
+
+    scheduler.printStatistics();
+
+    if (timing) {
+        cout << "TIMING load_ms=" << load_ms << " schedule_ms=" << schedule_ms
+             << " write_ms=" << write_ms << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,727 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "scheduler.h"
+
+using namespace std;
+
+// Behavioural tests for the scheduling library: every engine and mode runs
+// on small generated instances and its schedule is checked against the
+// enrollment rules and against the greedy engine on the same input.
+
+// A generated instance: records for the library, plus each course's hours
+// so schedules can be checked for time conflicts without parsing slots
+struct Instance {
+    vector<StudentRecord> students;
+    vector<CourseRecord> courses;
+    vector<vector<int>> course_hours;       // per course: day * 24 + hour
+    vector<vector<int>> unavailable_hours;  // per student
+};
+
+static const char* DAYS[] = {"Monday", "Tuesday", "Wednesday", "Thursday", "Friday"};
+
+static string hourSlot(int slot) {
+    ostringstream text;
+    int hour = 8 + slot % 9;
+    text << DAYS[slot / 9] << "_" << setw(2) << setfill('0') << hour << ":00-" << setw(2) << setfill('0')
+         << hour + 1 << ":00";
+    return text.str();
+}
+
+// Instance in the shape of the benchmark: three-unit sections with three
+// hourly meetings, one-unit electives and preferences skewed towards
+// three-unit courses. The default of seats for 3.5 enrollments per student
+// keeps it contended.
+static Instance makeInstance(int num_students, uint32_t seed, double seats_per_student = 3.5) {
+    mt19937 rng(seed);
+    int num_3unit = max(num_students / 25, 12);
+    int num_1unit = max(num_3unit / 3, 4);
+    int seats = max(10, (int)(num_students * seats_per_student / (num_3unit + num_1unit)));
+    uniform_int_distribution<> slot_dist(0, 44);
+
+    Instance instance;
+    for (int i = 0; i < num_3unit + num_1unit; i++) {
+        bool three_unit = i < num_3unit;
+        CourseRecord course;
+        course.id = three_unit ? "COURSE3_" + to_string(i + 1) : "COURSE1_" + to_string(i - num_3unit + 1);
+        course.name = "Course " + to_string(i + 1);
+        course.units = three_unit ? 3 : 1;
+        course.max_students = seats;
+        course.instructor = "Dr. Smith";
+        course.room = "Room A101";
+        vector<int> hours;
+        for (int j = 0; j < (three_unit ? 3 : 1); j++) {
+            int slot = slot_dist(rng);
+            course.time_slots.push_back(hourSlot(slot) + ":1");
+            hours.push_back(slot / 9 * 24 + 8 + slot % 9);
+        }
+        instance.courses.push_back(course);
+        instance.course_hours.push_back(hours);
+    }
+
+    const pair<int, int> unit_ranges[] = {{12, 15}, {9, 12}, {15, 18}, {9, 12}};
+    uniform_int_distribution<> range_dist(0, 3);
+    uniform_int_distribution<> pref_count_dist(3, 6);
+    uniform_int_distribution<> course3_dist(0, num_3unit - 1);
+    uniform_int_distribution<> course1_dist(num_3unit, num_3unit + num_1unit - 1);
+    uniform_int_distribution<> percent_dist(0, 99);
+    for (int i = 1; i <= num_students; i++) {
+        StudentRecord student;
+        student.id = i;
+        student.name = "Student " + to_string(i);
+        auto range = unit_ranges[range_dist(rng)];
+        student.min_units = range.first;
+        student.max_units = range.second;
+        int num_prefs = pref_count_dist(rng);
+        for (int j = 0; j < num_prefs; j++) {
+            int course = percent_dist(rng) < 80 ? course3_dist(rng) : course1_dist(rng);
+            student.preferred_courses.push_back(instance.courses[course].id);
+        }
+        vector<int> unavailable;
+        if (percent_dist(rng) < 30) {
+            int slot = slot_dist(rng);
+            student.unavailable_times.push_back(hourSlot(slot));
+            unavailable.push_back(slot / 9 * 24 + 8 + slot % 9);
+        }
+        instance.students.push_back(student);
+        instance.unavailable_hours.push_back(unavailable);
+    }
+    return instance;
+}
+
+static int failures = 0;
+
+static void check(bool passed, const string& test_name, const string& detail = "") {
+    cout << (passed ? "  PASS " : "  FAIL ") << test_name;
+    if (!passed && !detail.empty()) cout << ": " << detail;
+    cout << endl;
+    if (!passed) failures++;
+}
+
+// Checks every enrollment rule on the schedule: units within the student's
+// maximum and adding up, at most 2 one-unit courses, no time conflicts or
+// unavailable hours, no course over capacity, and the success flag set
+// exactly for students at their minimum with 3 three-unit courses. Returns
+// an empty string or the first violation.
+static string scheduleViolation(const Scheduler& scheduler, const Instance& instance) {
+    unordered_map<string, size_t> course_of_id;
+    for (size_t c = 0; c < instance.courses.size(); c++) course_of_id[instance.courses[c].id] = c;
+    unordered_map<int, size_t> student_of_id;
+    for (size_t s = 0; s < instance.students.size(); s++) student_of_id[instance.students[s].id] = s;
+    vector<int> enrolled(instance.courses.size(), 0);
+    vector<bool> seen(instance.students.size(), false);
+
+    for (const StudentSchedule& schedule : scheduler) {
+        auto found = student_of_id.find(schedule.id);
+        if (found == student_of_id.end() || seen[found->second]) {
+            return "unexpected schedule for student " + to_string(schedule.id);
+        }
+        size_t s = found->second;
+        seen[s] = true;
+        const StudentRecord& student = instance.students[s];
+
+        int units = 0, three_units = 0, one_units = 0;
+        vector<int> hours = instance.unavailable_hours[s];
+        for (uint32_t course : schedule) {
+            size_t c = course_of_id.at(string(scheduler.courseId(course)));
+            const CourseRecord& record = instance.courses[c];
+            units += record.units;
+            (record.units == 3 ? three_units : one_units)++;
+            enrolled[c]++;
+            for (int hour : instance.course_hours[c]) {
+                if (find(hours.begin(), hours.end(), hour) != hours.end()) {
+                    return "student " + to_string(student.id) + " has a time conflict in " + record.id;
+                }
+            }
+            hours.insert(hours.end(), instance.course_hours[c].begin(), instance.course_hours[c].end());
+        }
+        string who = "student " + to_string(student.id);
+        if (units != schedule.total_units) return who + " reports " + to_string(schedule.total_units) + " units";
+        if (units > student.max_units) return who + " is over their maximum units";
+        if (one_units > 2) return who + " holds more than 2 one-unit courses";
+        bool meets = units >= student.min_units && three_units >= 3;
+        if (meets != schedule.successful) return who + " has the wrong success flag";
+    }
+    if (find(seen.begin(), seen.end(), false) != seen.end()) return "missing schedules";
+    for (size_t c = 0; c < instance.courses.size(); c++) {
+        if (enrolled[c] > instance.courses[c].max_students) return instance.courses[c].id + " is over capacity";
+    }
+    return "";
+}
+
+static bool loadInstance(Scheduler& scheduler, const Instance& instance) {
+    scheduler.setLog(nullptr);
+    return scheduler.load(instance.students, instance.courses);
+}
+
+// Students the greedy engine schedules on instance with seed
+static size_t greedyCount(const Instance& instance, uint32_t seed) {
+    Scheduler scheduler(seed);
+    loadInstance(scheduler, instance);
+    scheduler.scheduleStudents();
+    return scheduler.successfulCount();
+}
+
+// Share of what greedy schedules that the other engines must reach on the
+// generated instances
+static const double SHARE = 0.95;
+
+// Runs engine on instance and checks the schedule is valid and schedules at
+// least share of what greedy schedules with the same seed; configure sets
+// any further options
+static void checkEngine(const string& name, Engine engine, const Instance& instance, double share,
+                        function<void(Scheduler&)> configure = nullptr) {
+    Scheduler scheduler(7);
+    loadInstance(scheduler, instance);
+    scheduler.setEngine(engine);
+    if (configure) configure(scheduler);
+    scheduler.scheduleStudents();
+
+    string violation = scheduleViolation(scheduler, instance);
+    check(violation.empty(), name + " schedule is valid", violation);
+    size_t greedy = greedyCount(instance, 7);
+    check(scheduler.successfulCount() >= share * greedy, name + " schedules about as many students as greedy",
+          to_string(scheduler.successfulCount()) + " against " + to_string(greedy));
+}
+
+static void testFlow() {
+    for (uint32_t seed : {1u, 2u}) {
+        Instance instance = makeInstance(400, seed);
+        checkEngine("flow (instance " + to_string(seed) + ")", Engine::Flow, instance, SHARE);
+    }
+}
+
+// The search starts from a greedy pass, so even when its node limit stops
+// it early it must match greedy at least
+static void testExact() {
+    for (uint32_t seed : {1u, 2u}) {
+        Instance instance = makeInstance(100, seed);
+        checkEngine("exact (instance " + to_string(seed) + ")", Engine::Exact, instance, 1.0,
+                    [](Scheduler& scheduler) { scheduler.setExactLimits(200000, 0); });
+    }
+}
+
+// Local search only keeps changes that schedule one more student, so it
+// matches greedy at least, also when seats are short and it must eject
+// holders of partial schedules
+static void testImprove() {
+    for (uint32_t seed : {1u, 2u}) {
+        Instance instance = makeInstance(300, seed, 2.5);
+        checkEngine("improvement (instance " + to_string(seed) + ")", Engine::Greedy, instance, 1.0,
+                    [](Scheduler& scheduler) { scheduler.setImproveBudget(50); });
+    }
+}
+
+static void testConcurrent() {
+    for (uint32_t seed : {1u, 2u}) {
+        Instance instance = makeInstance(400, seed);
+        for (size_t threads : {1, 4}) {
+            checkEngine("concurrent on " + to_string(threads) + " threads (instance " + to_string(seed) + ")",
+                        Engine::Concurrent, instance, SHARE,
+                        [threads](Scheduler& scheduler) { scheduler.setThreadCount(threads); });
+        }
+    }
+}
+
+static void testDraft() {
+    for (uint32_t seed : {1u, 2u, 3u}) {
+        Instance instance = makeInstance(400, seed);
+        checkEngine("draft (instance " + to_string(seed) + ")", Engine::Draft, instance, SHARE);
+    }
+}
+
+// Each student's outcome as text, keyed by ID, to compare two schedulers
+static unordered_map<int, string> scheduleText(const Scheduler& scheduler) {
+    unordered_map<int, string> text;
+    for (const StudentSchedule& schedule : scheduler) {
+        vector<string> courses;
+        for (uint32_t course : schedule) courses.emplace_back(scheduler.courseId(course));
+        sort(courses.begin(), courses.end());
+        string& line = text[schedule.id];
+        line = to_string(schedule.total_units) + (schedule.successful ? "|yes|" : "|no|");
+        for (const auto& course : courses) line += course + ",";
+    }
+    return text;
+}
+
+static string readFile(const string& path) {
+    ifstream file(path, ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+// An instance in the students and courses file formats
+static void instanceText(const Instance& instance, string& students_text, string& courses_text) {
+    auto list = [](const vector<string>& items) {
+        string text;
+        for (size_t i = 0; i < items.size(); i++) text += (i > 0 ? "," : "") + items[i];
+        return text;
+    };
+    for (const auto& student : instance.students) {
+        students_text += to_string(student.id) + '|' + student.name + '|' + to_string(student.min_units) + '|' +
+                         to_string(student.max_units) + '|' + list(student.preferred_courses) + '|' +
+                         list(student.unavailable_times) + '\n';
+    }
+    for (const auto& course : instance.courses) {
+        courses_text += course.id + '|' + course.name + '|' + to_string(course.units) + '|' +
+                        to_string(course.max_students) + '|' + course.instructor + '|' + course.room + '|' +
+                        list(course.time_slots) + '\n';
+    }
+}
+
+// Fields are split by position, so empty preferences and an empty trailing
+// UnavailableTimes field still load, while a line short of a field does not
+static void testEmptyFields() {
+    Scheduler scheduler(7);
+    scheduler.setLog(nullptr);
+    scheduler.loadStudentsText("1|Ann|9|9|MATH101,PHYS101,CHEM101|\n"
+                               "2|Bob|9|9||\n"
+                               "3|Cy|9|9|MATH101\n");
+    scheduler.loadCoursesText("MATH101|Calculus|3|5|Dr. Smith|Room A101|Monday_09:00-10:00:1\n"
+                              "PHYS101|Physics|3|5|Dr. Lee|Room A102|Monday_10:00-11:00:1\n"
+                              "CHEM101|Chemistry|3|5|Dr. Park|Room A103|Monday_11:00-12:00:1\n");
+    scheduler.scheduleStudents();
+    check(scheduler.studentCount() == 2, "empty fields load and a short line is skipped",
+          to_string(scheduler.studentCount()) + " students");
+    bool ann_scheduled = false;
+    for (const StudentSchedule& schedule : scheduler) {
+        if (schedule.id == 1) ann_scheduled = schedule.successful && schedule.name == "Ann";
+    }
+    check(ann_scheduled, "a student with no unavailable times is scheduled");
+}
+
+// Records load the same instance as the text formats, and keep text fields
+// as given even when they hold the formats' separators
+static void testRecords() {
+    Instance instance = makeInstance(300, 6);
+    string students_text, courses_text;
+    instanceText(instance, students_text, courses_text);
+    Scheduler from_text(7);
+    from_text.setLog(nullptr);
+    from_text.loadStudentsText(students_text);
+    from_text.loadCoursesText(courses_text);
+    from_text.scheduleStudents();
+    Scheduler from_records(7);
+    loadInstance(from_records, instance);
+    from_records.scheduleStudents();
+    check(scheduleText(from_records) == scheduleText(from_text), "records schedule like the text formats");
+
+    const string name = "Doe, Jane | Registrar";
+    instance.students[0].name = name;
+    instance.courses[0].name = "Algebra | Part I, Section 2";
+    instance.courses[0].instructor = "Smith, J.";
+    Scheduler separators(7);
+    check(loadInstance(separators, instance), "records with separators in names load");
+    separators.scheduleStudents();
+    string violation = scheduleViolation(separators, instance);
+    check(violation.empty(), "records with separators in names schedule validly", violation);
+    check(scheduleText(separators) == scheduleText(from_records), "names do not change the schedule");
+    string kept;
+    for (const StudentSchedule& schedule : separators) {
+        if (schedule.id == instance.students[0].id) kept = string(schedule.name);
+    }
+    check(kept == name, "records keep separators in names", kept);
+
+    // Standard algorithms take the schedule iterators
+    static_assert(is_same_v<iterator_traits<Scheduler::ScheduleIterator>::iterator_category, input_iterator_tag>);
+    vector<StudentSchedule> schedules(separators.begin(), separators.end());
+    check(schedules.size() == separators.studentCount(), "schedule iterators fill a vector");
+    check(count_if(separators.begin(), separators.end(), [](const StudentSchedule& schedule) {
+              return schedule.successful;
+          }) == (ptrdiff_t)separators.successfulCount(), "schedule iterators count successes");
+}
+
+// Three students who need MATH101, which has one seat, besides two roomy
+// courses: each seat added schedules one more of them, and taking the seat
+// away unschedules its holder. HIST101 meets when they are all unavailable.
+static void testWhatIf() {
+    vector<CourseRecord> courses(4);
+    courses[0] = {"MATH101", "Calculus", 3, 1, "Dr. Smith", "Room A101", {"Monday_09:00-10:00:1"}};
+    courses[1] = {"PHYS101", "Physics", 3, 5, "Dr. Lee", "Room A102", {"Monday_10:00-11:00:1"}};
+    courses[2] = {"CHEM101", "Chemistry", 3, 5, "Dr. Park", "Room A103", {"Monday_11:00-12:00:1"}};
+    courses[3] = {"HIST101", "History", 3, 5, "Dr. Jones", "Room B202", {"Tuesday_09:00-10:00:1"}};
+    vector<StudentRecord> students;
+    for (int id = 1; id <= 3; id++) {
+        students.push_back({id, "Student " + to_string(id), 9, 9, {"MATH101", "PHYS101", "CHEM101"},
+                            {"Tuesday_09:00-10:00"}});
+    }
+    Scheduler scheduler(7);
+    scheduler.setLog(nullptr);
+    scheduler.load(students, courses);
+    scheduler.scheduleStudents();
+
+    vector<CapacityChange> changes = {{"HIST101", 3}, {"MATH101", -1}, {"MATH101", 1}, {"NONE", 1}, {"MATH101", 2}};
+    CapacityReport report = scheduler.evaluateCapacityChanges(changes);
+    check(report.scheduled == 1, "what-if starts from the schedule", to_string(report.scheduled));
+    check(report.unknown == vector<size_t>{3}, "what-if lists the unknown course");
+
+    struct Expected {
+        size_t change;
+        long long gain;
+        size_t displaced;
+    };
+    const Expected expected[] = {{4, 2, 0}, {2, 1, 0}, {0, 0, 0}, {1, -1, 1}};
+    bool ranked = report.ranked.size() == 4;
+    for (size_t i = 0; ranked && i < 4; i++) {
+        const CapacityGain& gain = report.ranked[i];
+        ranked = gain.change == expected[i].change && gain.gain == expected[i].gain &&
+                 gain.displaced == expected[i].displaced && (long long)gain.scheduled == 1 + expected[i].gain;
+    }
+    check(ranked, "what-if ranks changes by gain");
+    check(scheduler.successfulCount() == 1, "what-if leaves the schedule as it was");
+}
+
+// Fresh directory for a test's files, removed by removeDirectory
+static string makeDirectory() {
+    char path[] = "/tmp/scheduler_tests.XXXXXX";
+    return mkdtemp(path) ? path : "";
+}
+
+static void removeDirectory(const string& path) {
+    if (!path.empty()) system(("rm -rf '" + path + "'").c_str());
+}
+
+// Sends request lines to the daemon listening at path, retrying the
+// connection while it starts up, and returns one reply per line
+static vector<string> daemonRequests(const string& path, const vector<string>& lines) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int client = -1;
+    for (int attempt = 0; attempt < 200 && client < 0; attempt++) {
+        client = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(client, (sockaddr*)&address, sizeof(address)) != 0) {
+            close(client);
+            client = -1;
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    }
+    vector<string> replies;
+    if (client < 0) return replies;
+
+    string requests;
+    for (const auto& line : lines) requests += line + "\n";
+    if (send(client, requests.data(), requests.size(), MSG_NOSIGNAL) == (ssize_t)requests.size()) {
+        string received;
+        char buffer[4096];
+        ssize_t got;
+        while (replies.size() < lines.size() && (got = read(client, buffer, sizeof(buffer))) > 0) {
+            received.append(buffer, got);
+            size_t end;
+            while ((end = received.find('\n')) != string::npos) {
+                replies.push_back(received.substr(0, end));
+                received.erase(0, end + 1);
+            }
+        }
+    }
+    close(client);
+    return replies;
+}
+
+// Whether a ROSTER reply, OK|enrolled|max|ids, lists the student ID
+static bool rosterLists(const string& reply, const string& id) {
+    string ids = "," + reply.substr(reply.rfind('|') + 1) + ",";
+    return reply.rfind("OK|", 0) == 0 && ids.find("," + id + ",") != string::npos;
+}
+
+// The daemon answers queries and changes from the schedule, and a second
+// serve() on the same scheduler runs until it too is stopped
+static void testDaemon() {
+    Instance instance = makeInstance(200, 4, 8);
+    Scheduler scheduler(7);
+    loadInstance(scheduler, instance);
+    scheduler.scheduleStudents();
+    string directory = makeDirectory();
+    string socket_path = directory + "/daemon.sock";
+
+    // serve() restores the handler it replaced, so a stray SIGINT after a
+    // failed start cannot end the test run
+    signal(SIGINT, SIG_IGN);
+
+    for (int run = 1; run <= 2; run++) {
+        string name = "daemon (run " + to_string(run) + ")";
+        bool served = false;
+        thread daemon([&] { served = scheduler.serve(socket_path); });
+
+        // A student with a feasible course enrolls in it, shows up in its
+        // roster and drops it again
+        string student, course;
+        for (const StudentSchedule& schedule : scheduler) {
+            vector<string> reply = daemonRequests(socket_path, {"FEASIBLE|" + to_string(schedule.id)});
+            if (reply.empty()) break;
+            if (reply[0].size() > 3) {
+                student = to_string(schedule.id);
+                size_t comma = reply[0].find(',');
+                course = reply[0].substr(3, comma == string::npos ? string::npos : comma - 3);
+                break;
+            }
+        }
+        check(!student.empty(), name + " finds a student with a feasible course");
+        vector<string> replies = daemonRequests(socket_path, {"ENROLL|" + student + "|" + course, "ROSTER|" + course,
+                                                              "DROP|" + student + "|" + course, "ROSTER|" + course,
+                                                              "DROP|" + student + "|" + course, "BAD"});
+        bool answered = replies.size() == 6;
+        check(answered && replies[0].rfind("OK|", 0) == 0, name + " enrolls", answered ? replies[0] : "no reply");
+        check(answered && rosterLists(replies[1], student), name + " lists the enrollment in the roster",
+              answered ? replies[1] : "");
+        check(answered && replies[2].rfind("OK|", 0) == 0, name + " drops", answered ? replies[2] : "");
+        check(answered && !rosterLists(replies[3], student), name + " removes the drop from the roster",
+              answered ? replies[3] : "");
+        check(answered && replies[4] == "ERR|not enrolled", name + " refuses a second drop", answered ? replies[4] : "");
+        check(answered && replies[5] == "ERR|bad request", name + " rejects a bad request", answered ? replies[5] : "");
+
+        raise(SIGINT);
+        daemon.join();
+        check(served, name + " stops cleanly on SIGINT");
+    }
+    removeDirectory(directory);
+}
+
+// Daemon changes made after the snapshot are replayed from the journal by a
+// fresh scheduler, with or without the snapshot, a change the journal cannot
+// write is undone, and journals that cannot be trusted are refused
+static void testJournal() {
+    Instance instance = makeInstance(200, 5, 8);
+    string directory = makeDirectory();
+    string journal = directory + "/term";
+    signal(SIGINT, SIG_IGN);
+
+    Scheduler original(7);
+    loadInstance(original, instance);
+    bool recovered = true;
+    check(original.openJournal(journal, recovered) && !recovered, "journal opens fresh");
+    original.scheduleStudents();
+    check(original.checkpoint(), "journal writes the first snapshot");
+
+    // Changes through the daemon, then a stop without the closing snapshot,
+    // as if the process died
+    string socket_path = directory + "/daemon.sock";
+    thread daemon([&] { original.serve(socket_path); });
+    size_t changes = 0;
+    for (const StudentSchedule& schedule : original) {
+        if (changes == 10) break;
+        vector<string> reply = daemonRequests(socket_path, {"FEASIBLE|" + to_string(schedule.id)});
+        if (reply.empty()) break;
+        if (reply[0].size() <= 3) continue;
+        size_t comma = reply[0].find(',');
+        string course = reply[0].substr(3, comma == string::npos ? string::npos : comma - 3);
+        reply = daemonRequests(socket_path, {"ENROLL|" + to_string(schedule.id) + "|" + course});
+        if (!reply.empty() && reply[0].rfind("OK|", 0) == 0) changes++;
+    }
+    raise(SIGINT);
+    daemon.join();
+    check(changes == 10, "daemon makes the changes to replay", to_string(changes) + " changes");
+
+    Scheduler restored(7);
+    loadInstance(restored, instance);
+    check(restored.openJournal(journal, recovered) && recovered, "journal recovers from the snapshot");
+    check(scheduleText(restored) == scheduleText(original), "recovered schedule matches the lost one");
+    check(restored.successfulCount() == original.successfulCount(), "recovered success count matches");
+
+    // A change the journal cannot write is refused and undone, and the
+    // broken journal refuses the changes after it. The file size limit
+    // makes the next journal write fail.
+    struct stat wal;
+    rlimit saved_limit;
+    getrlimit(RLIMIT_FSIZE, &saved_limit);
+    stat((journal + ".wal").c_str(), &wal);
+    signal(SIGXFSZ, SIG_IGN);
+    thread failing([&] { restored.serve(socket_path); });
+    string student, course;
+    for (const StudentSchedule& schedule : restored) {
+        vector<string> reply = daemonRequests(socket_path, {"FEASIBLE|" + to_string(schedule.id)});
+        if (reply.empty()) break;
+        if (reply[0].size() <= 3) continue;
+        student = to_string(schedule.id);
+        size_t comma = reply[0].find(',');
+        course = reply[0].substr(3, comma == string::npos ? string::npos : comma - 3);
+        break;
+    }
+    rlimit limit = saved_limit;
+    limit.rlim_cur = wal.st_size;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    vector<string> replies = daemonRequests(socket_path, {"ENROLL|" + student + "|" + course, "ROSTER|" + course,
+                                                          "ENROLL|" + student + "|" + course});
+    setrlimit(RLIMIT_FSIZE, &saved_limit);
+    raise(SIGINT);
+    failing.join();
+    bool answered = replies.size() == 3;
+    check(answered && replies[0] == "ERR|journal write failed", "journal failure refuses the change",
+          answered ? replies[0] : "no reply");
+    check(answered && !rosterLists(replies[1], student), "journal failure undoes the change",
+          answered ? replies[1] : "");
+    check(answered && replies[2] == "ERR|journal write failed", "broken journal refuses later changes",
+          answered ? replies[2] : "");
+
+    // Without its snapshot, a journal that holds every change since the
+    // first schedule is replayed onto the schedule built again; once a
+    // checkpoint has cut its start, it is refused
+    unlink((journal + ".snap").c_str());
+    Scheduler rebuilt(7);
+    loadInstance(rebuilt, instance);
+    check(rebuilt.openJournal(journal, recovered) && !recovered, "journal without a snapshot schedules again");
+    rebuilt.scheduleStudents();
+    check(rebuilt.checkpoint(), "journal without a snapshot writes a new one");
+    check(scheduleText(rebuilt) == scheduleText(original), "journal without a snapshot replays its changes");
+    unlink((journal + ".snap").c_str());
+    Scheduler cut(7);
+    loadInstance(cut, instance);
+    check(!cut.openJournal(journal, recovered), "journal missing its earlier changes and snapshot is refused");
+
+    // A file that is not a journal is reported and left as it was
+    string foreign = directory + "/foreign";
+    ofstream(foreign + ".wal") << "not a scheduler journal\n";
+    Scheduler refused(7);
+    loadInstance(refused, instance);
+    check(!refused.openJournal(foreign, recovered), "journal refuses a foreign file");
+    check(readFile(foreign + ".wal") == "not a scheduler journal\n", "journal leaves a foreign file untouched");
+
+    // A seed cannot reproduce a schedule that depends on thread interleaving
+    Scheduler concurrent(7);
+    loadInstance(concurrent, instance);
+    concurrent.setEngine(Engine::Concurrent);
+    concurrent.setThreadCount(2);
+    check(!concurrent.openJournal(directory + "/concurrent", recovered),
+          "journal refuses the concurrent engine on several threads");
+    removeDirectory(directory);
+}
+
+// The stream engine writes the same results to a stream as to a file, and
+// they restore into a valid schedule with the successes the SUMMARY counts.
+// A window without slots is refused.
+static void testStream() {
+    Instance instance = makeInstance(400, 8);
+    string students_text, courses_text;
+    instanceText(instance, students_text, courses_text);
+    string directory = makeDirectory();
+    string students_file = directory + "/students.txt";
+    string results_file = directory + "/results.txt";
+    ofstream(students_file) << students_text;
+
+    Scheduler to_file(7);
+    to_file.setLog(nullptr);
+    to_file.loadCoursesText(courses_text);
+    check(to_file.scheduleStream(students_file, results_file, 64), "stream writes a results file");
+
+    Scheduler to_stream(7);
+    to_stream.setLog(nullptr);
+    to_stream.loadCoursesText(courses_text);
+    istringstream students_in(students_text);
+    ostringstream results;
+    check(to_stream.scheduleStream(students_in, results, 64), "stream writes a results stream");
+    check(results.str() == readFile(results_file), "stream writes the same results to a stream and a file");
+    istringstream no_students(students_text);
+    ostringstream no_results;
+    check(!to_stream.scheduleStream(no_students, no_results, 0), "stream refuses an empty lottery window");
+
+    Scheduler restored(7);
+    loadInstance(restored, instance);
+    check(restored.loadPreviousResults(results_file), "streamed results restore");
+    string violation = scheduleViolation(restored, instance);
+    check(violation.empty(), "streamed schedule is valid", violation);
+    string summary = "Successfully Scheduled: " + to_string(restored.successfulCount()) + " ";
+    check(results.str().find(summary) != string::npos, "stream SUMMARY counts the scheduled students");
+    size_t greedy = greedyCount(instance, 7);
+    check(restored.successfulCount() >= SHARE * greedy, "stream schedules about as many students as greedy",
+          to_string(restored.successfulCount()) + " against " + to_string(greedy));
+    removeDirectory(directory);
+}
+
+// Events apply alike as records and as lines, keep the schedule valid and
+// list the students they changed
+static void testEvents() {
+    Instance instance = makeInstance(300, 9);
+    Scheduler original(7);
+    loadInstance(original, instance);
+    original.scheduleStudents();
+    string directory = makeDirectory();
+    string previous = directory + "/previous.txt";
+    original.saveScheduleToFile(previous);
+
+    Scheduler restored(7);
+    loadInstance(restored, instance);
+    check(restored.loadPreviousResults(previous), "previous results restore");
+    check(scheduleText(restored) == scheduleText(original), "previous results restore the same schedule");
+
+    // A scheduled student drops a course, a course loses half its seats and
+    // an event names a course that does not exist
+    const StudentSchedule first = *find_if(original.begin(), original.end(), [](const StudentSchedule& schedule) {
+        return schedule.successful;
+    });
+    string dropped(original.courseId(*first.begin()));
+    Instance changed = instance;
+    CourseRecord& cut = changed.courses[1];
+    cut.max_students /= 2;
+    vector<EventRecord> events = {{EventKind::Drop, first.id, dropped, 0},
+                                  {EventKind::Capacity, 0, cut.id, cut.max_students},
+                                  {EventKind::Add, first.id, "NONE", 0}};
+    string events_text = "DROP|" + to_string(first.id) + "|" + dropped + "\n# comment\nCAPACITY|" + cut.id + "|" +
+                         to_string(cut.max_students) + "\nADD|" + to_string(first.id) + "|NONE\n";
+
+    Scheduler from_records(7), from_lines(7);
+    ostringstream records_delta, lines_delta;
+    for (Scheduler* scheduler : {&from_records, &from_lines}) {
+        loadInstance(*scheduler, instance);
+        scheduler->loadPreviousResults(previous);
+    }
+    istringstream events_in(events_text);
+    check(from_records.applyEvents(events, records_delta), "events apply as records");
+    check(from_lines.applyEvents(events_in, lines_delta), "events apply as lines");
+    check(records_delta.str() == lines_delta.str() && scheduleText(from_records) == scheduleText(from_lines),
+          "records and lines change the schedule alike");
+
+    string violation = scheduleViolation(from_records, changed);
+    check(violation.empty(), "schedule after events is valid", violation);
+    bool holds_dropped = false;
+    for (const StudentSchedule& schedule : from_records) {
+        if (schedule.id != first.id) continue;
+        for (uint32_t course : schedule) holds_dropped |= from_records.courseId(course) == dropped;
+    }
+    check(!holds_dropped, "a dropped course is not given back");
+    string delta = records_delta.str();
+    check(delta.find("2 events applied, 1 refused") != string::npos, "delta counts applied and refused events",
+          delta.substr(0, delta.find('\n')));
+    check(delta.find("\n" + to_string(first.id) + "|") != string::npos, "delta lists the student who dropped");
+    removeDirectory(directory);
+}
+
+int main() {
+    const pair<const char*, void (*)()> tests[] = {
+        {"Empty fields", testEmptyFields},
+        {"Records", testRecords},
+        {"Flow engine", testFlow},
+        {"Exact engine", testExact},
+        {"Improvement phase", testImprove},
+        {"Concurrent engine", testConcurrent},
+        {"Draft engine", testDraft},
+        {"Stream", testStream},
+        {"Events", testEvents},
+        {"Capacity what-if", testWhatIf},
+        {"Daemon", testDaemon},
+        {"Journal", testJournal},
+    };
+
+    for (const auto& [name, run] : tests) {
+        cout << name << endl;
+        run();
+    }
+    cout << endl << (failures == 0 ? "All tests passed" : to_string(failures) + " checks failed") << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <set>
 
+#include "generator_seed.h"
+
 using namespace std;
 
 struct Student {
@@ -59,7 +61,7 @@ private:
     };
 
 public:
-    StudentGenerator() : rng(random_device{}()) {}
+    explicit StudentGenerator(uint32_t seed) : rng(seed) {}
 
     string generateName() {
         uniform_int_distribution<> first_dist(0, first_names.size() - 1);
@@ -174,8 +176,10 @@ public:
     }
 };
 
-int main() {
-    StudentGenerator generator;
+int main(int argc, char* argv[]) {
+    uint32_t seed = 0;
+    if (!seedFromArgs(argc, argv, seed)) return 1;
+    StudentGenerator generator(seed);
     vector<Student> students = generator.generateStudents(100);
     generator.saveStudentsToFile(students, "students.txt");
 
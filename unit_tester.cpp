@@ -99,6 +99,23 @@ public:
         return tokens;
     }
 
+    // Splits a '|' record the way the scheduler does: empty fields,
+    // including a trailing one, keep their position
+    vector<string> splitFields(const string& str, char delimiter) {
+        vector<string> fields;
+        if (str.length() > 5000) return fields;
+
+        size_t pos = 0;
+        while (fields.size() < 100) {
+            size_t end = str.find(delimiter, pos);
+            if (end == string::npos) end = str.length();
+            fields.push_back(str.substr(pos, end - pos));
+            if (end == str.length()) break;
+            pos = end + 1;
+        }
+        return fields;
+    }
+
     int safeStringToInt(const string& str, int default_value = 0) {
         if (str.empty() || str.length() > 10) return default_value;
         try {
@@ -153,7 +170,7 @@ public:
         while (getline(sfile, line) && student_count < 1000) {
             if (line.empty() || line[0] == '#') continue;
 
-            vector<string> parts = safeSplit(line, '|');
+            vector<string> parts = splitFields(line, '|');
             if (parts.size() != 6) continue;
 
             try {
@@ -194,7 +211,7 @@ public:
         while (getline(cfile, line) && course_count < 100) {
             if (line.empty() || line[0] == '#') continue;
 
-            vector<string> parts = safeSplit(line, '|');
+            vector<string> parts = splitFields(line, '|');
             if (parts.size() != 7) continue;
 
             try {
@@ -262,7 +279,7 @@ public:
             if (in_student_section && !line.empty() && line[0] != '#' &&
                 line.find("Format:") == string::npos) {
 
-                vector<string> parts = safeSplit(line, '|');
+                vector<string> parts = splitFields(line, '|');
                 if (parts.size() >= 4) {
                     try {
                         ScheduleResult result;